@@ -8,10 +8,15 @@
 
 layout(set = 0, binding = BINDING_SCENE) uniform accelerationStructureNV scene;
 
-layout(set = 0, binding = BINDING_OUTPUT, rgba8) uniform image2D resultImage;
+// Read by restir.rgen, which adds the resampled direct light
+layout(set = 0, binding = BINDING_COLOR, rgba32f) uniform image2D colorImage;
 
-layout(set = 0, binding = BINDING_SETTINGS) uniform RayTracingSettingsBuffer {
-    RayTracingSettings rayTracingSettings;
+layout(set = 0, binding = BINDING_MOTION, rgba16f) uniform writeonly image2D motionImage;
+
+layout(set = 0, binding = BINDING_NORMAL_DEPTH, rgba16f) uniform writeonly image2D normalDepthImage;
+
+layout(set = 0, binding = BINDING_FRAME) uniform FrameBuffer {
+    Frame frame;
 };
 
 layout(set = 0, binding = BINDING_CAMERA) uniform CameraBuffer {
@@ -30,18 +35,18 @@ layout(set = 0, binding = BINDING_SPHERE_BUFFERS, std430) readonly buffer Sphere
     Sphere sphere;
 } spheres[];
 
-layout(set = 0, binding = BINDING_INSTANCE_BUFFERS, std430) readonly buffer InstanceBuffer {
-    Instance instance;
-} instances[];
-
 layout(set = 0, binding = BINDING_MATERIAL_BUFFERS, std430) readonly buffer MaterialBuffer {
     Material material;
 } materials[];
 
-layout(set = 0, binding = BINDING_LIGHT_BUFFER) uniform LightBuffer {
-    Light light;
+layout(set = 0, binding = BINDING_LIGHT_BUFFER, std430) readonly buffer LightBuffer {
+    Light lights[];
 };
 
+layout(set = 0, binding = BINDING_RESERVOIRS, std430) buffer ReservoirBuffer {
+    Reservoir reservoirs[];
+} reservoirBuffers[2];
+
 layout(set = 0, binding = BINDING_TEXTURE_SAMPLERS) uniform sampler2D[] textures;
 
 #endif
\ No newline at end of file
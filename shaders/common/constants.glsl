@@ -5,14 +5,79 @@ const float PI = 3.14159265359;
 
 const uint BINDING_SCENE = 0;
 const uint BINDING_OUTPUT = 1;
-const uint BINDING_SETTINGS = 2;
+const uint BINDING_ACCUMULATION = 2;
 const uint BINDING_CAMERA = 3;
 const uint BINDING_VERTEX_BUFFERS = 4;
 const uint BINDING_INDEX_BUFFERS = 5;
 const uint BINDING_SPHERE_BUFFERS = 6;
-const uint BINDING_INSTANCE_BUFFERS = 7;
+const uint BINDING_FRAME = 7;
 const uint BINDING_MATERIAL_BUFFERS = 8;
 const uint BINDING_TEXTURE_SAMPLERS = 9;
 const uint BINDING_LIGHT_BUFFER = 10;
+const uint BINDING_COLOR = 11;
+const uint BINDING_MOTION = 12;
+const uint BINDING_NORMAL_DEPTH = 13;
+const uint BINDING_DENOISE = 14;
+const uint BINDING_LIGHT_TREE = 15;
+const uint BINDING_RESERVOIRS = 16;
+const uint BINDING_WAVEFRONT_RAYS = 17;
+const uint BINDING_WAVEFRONT_HITS = 18;
+const uint BINDING_WAVEFRONT_SORTED = 19;
+const uint BINDING_WAVEFRONT_SHADOW_RAYS = 20;
+const uint BINDING_WAVEFRONT_STATE = 21;
+const uint BINDING_WAVEFRONT_RADIANCE = 22;
+
+// Frame::accumulationMode
+const uint ACCUMULATION_OFF = 0;
+const uint ACCUMULATION_PROGRESSIVE = 1;
+const uint ACCUMULATION_TEMPORAL = 2;
+
+// Frame::lightSampling
+const uint LIGHT_SAMPLING_TREE = 0;
+const uint LIGHT_SAMPLING_RESTIR = 1;
+
+// Reservoir buffers, the current one is written by the primary hits and resampled in place by
+// restir_temporal.comp, the history by restir.rgen
+const uint RESERVOIRS_CURRENT = 0;
+const uint RESERVOIRS_HISTORY = 1;
+
+// Ray tracing settings, set as specialization constants by RaytracingPipeline::create()
+layout(constant_id = 0) const uint MAX_BOUNCES = 1;
+layout(constant_id = 1) const float TMIN = 0.001f;
+layout(constant_id = 2) const float TMAX = 48.0f;
+layout(constant_id = 3) const uint SAMPLES_PER_PIXEL = 1;
+// Bounces are traced by a loop in primary.rgen instead of recursively from the hit shaders
+layout(constant_id = 4) const bool PATH_TRACING = false;
+
+// Every instance has a hit record per ray type, Scene::RAY_TYPE_* on the CPU. Passed to traceNV() as
+// sbtRecordOffset with RAY_TYPE_COUNT as sbtRecordStride
+const uint RAY_TYPE_PRIMARY = 0;
+const uint RAY_TYPE_SHADOW = 1;
+const uint RAY_TYPE_COUNT = 2;
+
+// Alpha tested materials are cut out below this mask value
+const float ALPHA_CUTOFF = 0.5f;
+
+// RayPayload::surface
+const uint SURFACE_NONE = 0;
+const uint SURFACE_DIFFUSE = 1;
+const uint SURFACE_REFLECTIVE = 2;
+const uint SURFACE_EMISSIVE = 3;
+
+// Hits of the wavefront path tracer are sorted by surface kind * WAVEFRONT_MATERIALS + material,
+// WavefrontScheduler on the CPU
+const uint WAVEFRONT_KINDS = 4;
+const uint WAVEFRONT_MATERIALS = 32;
+const uint WAVEFRONT_KEYS = WAVEFRONT_KINDS * WAVEFRONT_MATERIALS;
+
+// Invocations per work group of the kernels working on queues, dispatched indirectly in one dimension
+const uint WAVEFRONT_GROUP_SIZE = 256;
+
+// Passes of shaders/wavefront_sort.comp
+const uint WAVEFRONT_PASS_SCAN = 0;
+const uint WAVEFRONT_PASS_SCATTER = 1;
+
+// Bounces after which paths are terminated by russian roulette
+const uint RUSSIAN_ROULETTE_BOUNCES = 2;
 
 #endif
\ No newline at end of file
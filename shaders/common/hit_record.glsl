@@ -0,0 +1,12 @@
+#ifndef HIT_RECORD_GLSL_
+#define HIT_RECORD_GLSL_
+
+#include "types.glsl"
+
+// Inline data of the shader binding table record of the hit instance, written by Scene::getHitRecordData()
+layout(shaderRecordNV, std430) buffer HitRecord {
+    Instance instance;
+    Material material;
+} hitRecord;
+
+#endif
\ No newline at end of file
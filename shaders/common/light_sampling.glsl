@@ -0,0 +1,77 @@
+#ifndef LIGHT_SAMPLING_GLSL_
+#define LIGHT_SAMPLING_GLSL_
+
+#include "types.glsl"
+#include "bindings.glsl"
+#include "random.glsl"
+#include "light_tree.glsl"
+#include "restir.glsl"
+
+// Light sampling shared by the hit shaders and the path tracing loop in primary.rgen
+
+layout(location = 2) rayPayloadNV bool isShadowed;
+
+// Next event estimation with a single light picked from the light tree, so the cost per hit
+// does not grow with the number of lights
+vec3 sampleDirectLight(vec3 origin, vec3 N, inout uint seed) {
+    float pdf;
+    int lightIndex = sampleLight(origin, seed, pdf);
+
+    if (lightIndex < 0) {
+        return vec3(0.0f);
+    }
+
+    Light light = lights[lightIndex];
+    vec3 toLight = light.position.xyz - origin;
+    float distance2 = max(dot(toLight, toLight), 1e-4f);
+    float cosTheta = dot(normalize(toLight), N);
+
+    if (cosTheta <= 0.0f || pdf <= 0.0f) {
+        return vec3(0.0f);
+    }
+
+    // Shadow ray
+    const uint rayFlags = gl_RayFlagsTerminateOnFirstHitNV | gl_RayFlagsSkipClosestHitShaderNV;
+
+    isShadowed = true;
+    traceNV(scene, rayFlags, 0xFE, RAY_TYPE_SHADOW, RAY_TYPE_COUNT, 1, origin, TMIN, toLight, 1.0f, 2);
+
+    return isShadowed ? vec3(0.0f) : light.intensity.rgb * cosTheta / (distance2 * pdf);
+}
+
+// Resamples light tree samples by their unshadowed contribution into a reservoir, without tracing
+// shadow rays. The surface is filled in by the caller
+Reservoir sampleLightCandidates(vec3 origin, vec3 N, inout uint seed) {
+    Reservoir r = emptyReservoir();
+
+    for (uint i = 0; i < RESTIR_CANDIDATES; i++) {
+        float pdf;
+        int lightIndex = sampleLight(origin, seed, pdf);
+
+        if (lightIndex < 0) {
+            break;
+        }
+
+        float target = targetFunction(lights[lightIndex], origin, N);
+        updateReservoir(r, lightIndex, pdf > 0.0f ? target / pdf : 0.0f, 1.0f, seed);
+    }
+
+    r.sampleCount = float(RESTIR_CANDIDATES);
+
+    if (r.light >= 0) {
+        finalizeReservoir(r, targetFunction(lights[r.light], origin, N));
+    }
+
+    return r;
+}
+
+// Stores the reservoir of the primary hit of this launch for restir_temporal.comp
+void writeReservoir(Reservoir r, vec3 position, vec3 normal, float depth, vec3 albedo) {
+    r.position = vec4(position, 1.0f);
+    r.normalDepth = vec4(normal, depth);
+    r.albedo = vec4(albedo, 1.0f);
+
+    reservoirBuffers[RESERVOIRS_CURRENT].reservoirs[gl_LaunchIDNV.y * frame.extent.x + gl_LaunchIDNV.x] = r;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef LIGHT_TREE_GLSL_
+#define LIGHT_TREE_GLSL_
+
+#include "constants.glsl"
+#include "types.glsl"
+#include "random.glsl"
+
+// Light tree descent, shared by the ray tracing shaders and the shade kernels of the wavefront path tracer
+
+layout(set = 0, binding = BINDING_LIGHT_TREE, std430) readonly buffer LightTreeBuffer {
+    LightNode lightNodes[];
+};
+
+// Estimate of the light a tree node contributes to the given position: its power over the squared
+// distance to the center, which is clamped to the size of the bounds so nodes containing the
+// position are not favored without limit
+float lightImportance(LightNode node, vec3 position) {
+    vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+    vec3 extent = node.boundsMax - node.boundsMin;
+    vec3 d = center - position;
+
+    return node.power / max(dot(d, d), max(dot(extent, extent) * 0.25f, 1e-4f));
+}
+
+// Picks a light by descending the light tree, choosing each child in proportion to its importance.
+// Returns the light index and the probability of having picked it, or -1 if there are no lights
+int sampleLight(vec3 position, inout uint seed, out float pdf) {
+    pdf = 1.0f;
+
+    LightNode node = lightNodes[0];
+    if (node.power <= 0.0f) {
+        return -1;
+    }
+
+    while (node.child >= 0) {
+        LightNode left = lightNodes[node.child];
+        LightNode right = lightNodes[node.child + 1];
+
+        float importanceLeft = lightImportance(left, position);
+        float importanceRight = lightImportance(right, position);
+        float sum = importanceLeft + importanceRight;
+        float p = sum > 0.0f ? importanceLeft / sum : 0.5f;
+
+        if (rnd(seed) < p) {
+            node = left;
+            pdf *= p;
+        } else {
+            node = right;
+            pdf *= 1.0f - p;
+        }
+    }
+
+    return -node.child - 1;
+}
+
+#endif
\ No newline at end of file
@@ -3,49 +3,80 @@
 
 #include "types.glsl"
 #include "bindings.glsl"
+#include "light_sampling.glsl"
+
+// Material features are selected by the MATERIAL_* defines of the shader permutation,
+// see getMaterialDefines() in material_features.h
 
 layout(location = 0) rayPayloadInNV RayPayload payloadIn;
 layout(location = 1) rayPayloadNV RayPayload payloadOut;
-layout(location = 2) rayPayloadNV bool isShadowed;
 
 vec4 lighting(Instance instance, Material material, Vertex vertex) {
 
-    vec3 L = normalize(light.position.xyz - vertex.position.xyz);
-
     vec3 N = normalize(instance.normalMatrix * vertex.normal);
     vec3 T = normalize(instance.normalMatrix * vertex.tangent);
     vec3 B = cross(N, T);
 
     // Normal map
-    if (material.textureId[1] > -1) {
-        vec3 n = texture(textures[material.textureId[1]], vertex.tc).xyz * 2.0f - 1.0f;
-        n = normalize(vec3(n.x, n.y, n.z * 5.0f));
-        N = normalize(mat3(T, B, N) * n);
+#ifdef MATERIAL_NORMAL_MAP
+    vec3 n = texture(textures[material.textureId[1]], vertex.tc).xyz * 2.0f - 1.0f;
+    n = normalize(vec3(n.x, n.y, n.z * 5.0f));
+    N = normalize(mat3(T, B, N) * n);
+#endif
+
+    // Diffuse color
+#ifdef MATERIAL_ALBEDO_MAP
+    vec4 color = texture(textures[material.textureId[0]], vertex.tc);
+#else
+    vec4 color = material.color;
+#endif
+
+    // Reflection if diffuse color is white
+#ifdef MATERIAL_REFLECTIVE
+    const bool reflective = color == vec4(1.0f);
+#else
+    const bool reflective = false;
+#endif
+
+    // The path tracing loops in primary.rgen and the wavefront kernels only need the surface, it does the shading itself
+    if (PATH_TRACING) {
+        payloadIn.shadingNormal = N;
+        payloadIn.surface = reflective ? SURFACE_REFLECTIVE : SURFACE_DIFFUSE;
+        payloadIn.material = uint(max(instance.materialId, 0));
+        return color;
     }
 
-    // Shadow ray
     vec3 origin = gl_WorldRayOriginNV + gl_WorldRayDirectionNV * gl_HitTNV;
-    const uint rayFlags = gl_RayFlagsTerminateOnFirstHitNV | gl_RayFlagsOpaqueNV | gl_RayFlagsSkipClosestHitShaderNV;
 
-    isShadowed = true;
-    traceNV(scene, rayFlags, 0xFE, 0, 0, 1, origin, rayTracingSettings.tmin, light.position.xyz - origin, 1.0f, 2);
+    vec3 direct = vec3(0.0f);
 
-    // Diffuse color
-    vec4 color = (material.textureId[0] > -1) ? texture(textures[material.textureId[0]], vertex.tc) : material.color;
+    // Primary hits leave the direct light to ReSTIR, which resolves it from the reservoir written below
+    const bool resample = frame.lightSampling == LIGHT_SAMPLING_RESTIR && payloadIn.bounce == 0;
+    Reservoir reservoir;
 
-    // Reflection if diffuse color is white
-    if (color == vec4(1.0f) && payloadIn.bounce < rayTracingSettings.maxBounces) {
+    if (resample) {
+        reservoir = sampleLightCandidates(origin, N, payloadIn.seed);
+    } else {
+        direct = sampleDirectLight(origin, N, payloadIn.seed);
+    }
+
+    if (reflective && payloadIn.bounce < MAX_BOUNCES) {
         payloadOut.bounce = payloadIn.bounce + 1;
+        payloadOut.seed = payloadIn.seed;
 
-        traceNV(scene, gl_RayFlagsOpaqueNV, 0xFF, 0, 0, 0,
-            origin, rayTracingSettings.tmin, reflect(gl_WorldRayDirectionNV, N), rayTracingSettings.tmax, 1);
+        traceNV(scene, gl_RayFlagsNoneNV, 0xFF, RAY_TYPE_PRIMARY, RAY_TYPE_COUNT, 0,
+            origin, TMIN, reflect(gl_WorldRayDirectionNV, N), TMAX, 1);
 
+        payloadIn.seed = payloadOut.seed;
         color = payloadOut.color;
     }
 
-    // Diffuse lighting
-    float diffuse = isShadowed ? 0.2 : max(dot(L, N), 0.2);
-    return color * diffuse;
+    if (resample) {
+        writeReservoir(reservoir, origin, N, gl_HitTNV, color.rgb);
+    }
+
+    // Diffuse lighting with a constant ambient term
+    return vec4(color.rgb * (0.2f + direct), color.a);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef MOTION_GLSL_
+#define MOTION_GLSL_
+
+#include "hit_record.glsl"
+
+// Position of the hit point in the previous frame, following the motion of the instance. Only
+// available in closest hit shaders
+vec4 getPreviousPosition() {
+    vec3 position = gl_WorldRayOriginNV + gl_WorldRayDirectionNV * gl_HitTNV;
+    vec3 objectPosition = gl_WorldToObjectNV * vec4(position, 1.0f);
+
+    return hitRecord.instance.prevObjectToWorld * vec4(objectPosition, 1.0f);
+}
+
+#endif
\ No newline at end of file
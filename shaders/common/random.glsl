@@ -0,0 +1,34 @@
+#ifndef RANDOM_GLSL_
+#define RANDOM_GLSL_
+
+// Tiny encryption algorithm, used to derive decorrelated seeds from the pixel and frame index
+uint tea(uint v0, uint v1) {
+    uint s0 = 0;
+
+    for (uint n = 0; n < 16; n++) {
+        s0 += 0x9e3779b9;
+        v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
+        v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+    }
+
+    return v0;
+}
+
+// Linear congruential generator, returns a float in [0, 1)
+float rnd(inout uint seed) {
+    seed = 1664525u * seed + 1013904223u;
+    return float(seed & 0x00FFFFFF) / float(0x01000000);
+}
+
+// Direction around the normal, distributed proportionally to the cosine to it
+vec3 sampleCosineHemisphere(vec3 normal, inout uint seed) {
+    float r = sqrt(rnd(seed));
+    float phi = 2.0f * 3.14159265359f * rnd(seed);
+
+    vec3 tangent = normalize(abs(normal.x) > 0.5f ? cross(normal, vec3(0, 1, 0)) : cross(normal, vec3(1, 0, 0)));
+    vec3 bitangent = cross(normal, tangent);
+
+    return normalize(tangent * r * cos(phi) + bitangent * r * sin(phi) + normal * sqrt(max(1.0f - r * r, 0.0f)));
+}
+
+#endif
\ No newline at end of file
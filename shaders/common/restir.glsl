@@ -0,0 +1,77 @@
+#ifndef RESTIR_GLSL_
+#define RESTIR_GLSL_
+
+#include "types.glsl"
+#include "random.glsl"
+
+// Reservoir-based spatiotemporal importance resampling of the direct light (ReSTIR). Primary hits
+// keep one of several light tree samples in a reservoir, restir_temporal.comp merges it with the
+// reservoir of the previous frame and restir.rgen with the reservoirs of neighbouring pixels, before
+// tracing a single shadow ray to the light that survived
+
+// Light tree samples streamed through the reservoir of each primary hit
+const uint RESTIR_CANDIDATES = 8;
+
+// Upper bound of the samples the history may represent, relative to the candidates of one frame
+const float RESTIR_HISTORY_LIMIT = 20.0f;
+
+const uint RESTIR_SPATIAL_SAMPLES = 5;
+
+// Radius in pixels neighbours are picked from
+const float RESTIR_SPATIAL_RADIUS = 30.0f;
+
+Reservoir emptyReservoir() {
+    Reservoir r;
+    r.position = vec4(0.0f);
+    r.normalDepth = vec4(0.0f);
+    r.albedo = vec4(0.0f);
+    r.light = -1;
+    r.weightSum = 0.0f;
+    r.sampleCount = 0.0f;
+    r.weight = 0.0f;
+    return r;
+}
+
+// Luminance of the unshadowed light arriving at the surface, the distribution samples are resampled to
+float targetFunction(Light light, vec3 position, vec3 normal) {
+    vec3 toLight = light.position.xyz - position;
+    float distance2 = max(dot(toLight, toLight), 1e-4f);
+    float cosTheta = max(dot(normalize(toLight), normal), 0.0f);
+
+    return dot(light.intensity.rgb, vec3(0.2126f, 0.7152f, 0.0722f)) * cosTheta / distance2;
+}
+
+// Streams a sample with the given resampling weight into the reservoir, sampleCount is the number
+// of candidates it stands for
+void updateReservoir(inout Reservoir r, int light, float weight, float sampleCount, inout uint seed) {
+    r.weightSum += weight;
+    r.sampleCount += sampleCount;
+
+    if (rnd(seed) * r.weightSum < weight) {
+        r.light = light;
+    }
+}
+
+// Merges another reservoir into r. Target is the target function value of its light at the surface
+// of r, so the sample is reweighted for the surface it is reused on
+void combineReservoir(inout Reservoir r, Reservoir other, float target, inout uint seed) {
+    updateReservoir(r, other.light, target * other.weight * other.sampleCount, other.sampleCount, seed);
+}
+
+// Computes the contribution weight of the selected sample, given its target function value
+void finalizeReservoir(inout Reservoir r, float target) {
+    r.weight = (target > 0.0f && r.sampleCount > 0.0f) ? r.weightSum / (r.sampleCount * target) : 0.0f;
+}
+
+bool isValidReservoir(Reservoir r) {
+    return r.position.w != 0.0f;
+}
+
+// Reservoirs are only shared between pixels seeing a similar surface, otherwise their samples
+// would be weighted for the wrong target function
+bool isSimilarSurface(Reservoir a, Reservoir b) {
+    return dot(a.normalDepth.xyz, b.normalDepth.xyz) > 0.9f &&
+        abs(a.normalDepth.w - b.normalDepth.w) < 0.1f * a.normalDepth.w;
+}
+
+#endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef TYPES_GLSL_
 #define TYPES_GLSL_
 
+#include "constants.glsl"
+
 struct Vertex {
     vec4 position;
     vec3 normal;
@@ -20,6 +22,7 @@ struct Instance {
 	int objectId;
     int materialId;
     mat3 normalMatrix;
+    mat4 prevObjectToWorld;
 };
 
 struct Material {
@@ -30,22 +33,129 @@ struct Material {
 struct Camera {
     mat4 viewInverse;
     mat4 projInverse;
+    mat4 prevViewProj;
+};
+
+struct Frame {
+    uint index;
+    uint accumulatedFrames;
+    uint accumulationMode;
+    float exposure;
+    float whitePoint;
+    uint maxHistory;
+    uvec2 extent;
+    uint lightSampling;
+};
+
+// Push constants of the a-trous passes, AtrousFilter::Settings on the CPU
+struct AtrousSettings {
+    int step;
+    uint source;
+    uint target;
+    float sigmaLuminance;
+    float sigmaNormal;
+    float sigmaDepth;
 };
 
 struct Light {
     vec4 position;
-    vec4 diffuseColor;
+    vec4 intensity;
+};
+
+// Node of the light tree, LightTree::Node on the CPU
+struct LightNode {
+    vec3 boundsMin;
+    float power;
+    vec3 boundsMax;
+    // Index of the first of two adjacent children, or -(light index + 1) for leaves
+    int child;
+};
+
+// Light sample of a pixel's primary hit, together with the surface it was drawn for
+struct Reservoir {
+    // Shading point, w is 0 if the primary ray did not hit a lit surface
+    vec4 position;
+    // World space normal and hit distance
+    vec4 normalDepth;
+    // Color the direct light is multiplied with
+    vec4 albedo;
+    // Selected light, -1 if none
+    int light;
+    float weightSum;
+    // Number of candidates the reservoir represents
+    float sampleCount;
+    // Contribution weight of the selected light
+    float weight;
 };
 
 struct RayPayload {
+    // Radiance, or the albedo or emission of the surface when path tracing
     vec4 color;
+    // Hit position in the previous frame, or the ray direction with w = 0 on a miss
+    vec4 prevPosition;
+    // World space normal and hit distance, which is 0 on a miss
+    vec4 normalDepth;
+    // Normal including normal maps, only written when path tracing
+    vec3 shadingNormal;
     int bounce;
+    // Random number state, handed on to the hit shaders and back
+    uint seed;
+    // Kind of surface that was hit, SURFACE_*
+    uint surface;
+    // Material index of the hit instance, only written when path tracing
+    uint material;
+};
+
+// Path segment waiting in a queue of the wavefront path tracer
+struct WavefrontRay {
+    // Origin and tmin
+    vec4 origin;
+    vec4 direction;
+    // Product of the albedos along the path, a is 1 if emission of the next hit still counts
+    vec4 throughput;
+    // Linear index of the pixel the path belongs to
+    uint pixel;
+    uint bounce;
+    uint seed;
+    uint pad;
+};
+
+// Result of tracing the ray at the same index of the queue
+struct WavefrontHit {
+    // Albedo, or emission of lights and the sky
+    vec4 color;
+    // Shading normal and hit distance
+    vec4 normalDepth;
+    // Sort key, surface kind * WAVEFRONT_MATERIALS + material
+    uint key;
+    uint pad[3];
+};
+
+// Next event estimation sample, added to the radiance of the pixel if the light is visible
+struct WavefrontShadowRay {
+    vec4 origin;
+    // Unnormalized direction to the light
+    vec4 direction;
+    vec4 contribution;
+    uint pixel;
+    uint pad[3];
 };
 
-struct RayTracingSettings {
-    uint maxBounces;
-    float tmin;
-    float tmax;
+// Queue counters and sort state of the wavefront path tracer, WavefrontScheduler::State on the CPU
+struct WavefrontState {
+    // Ray queue read by the next trace, the other one receives the extension rays of the shade kernels
+    uint queue;
+    // Ray queue of the hits being sorted and shaded
+    uint shadeQueue;
+    uint rayCount[2];
+    uint shadowRayCount;
+    uint pad[3];
+    // Begin and end of every surface kind in the sorted hits
+    uvec4 kindRange[WAVEFRONT_KINDS];
+    // VkDispatchIndirectCommand of the shade kernel of every surface kind
+    uvec4 dispatch[WAVEFRONT_KINDS];
+    uint keyCount[WAVEFRONT_KEYS];
+    uint keyOffset[WAVEFRONT_KEYS];
 };
 
 #endif
\ No newline at end of file
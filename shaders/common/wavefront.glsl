@@ -0,0 +1,42 @@
+#ifndef WAVEFRONT_GLSL_
+#define WAVEFRONT_GLSL_
+
+#include "constants.glsl"
+#include "types.glsl"
+
+// Queues of the wavefront path tracer, shared by its ray generation shaders and compute kernels.
+// All queues hold one entry per pixel of the render targets
+
+layout(set = 0, binding = BINDING_WAVEFRONT_RAYS, std430) buffer WavefrontRayBuffer {
+    WavefrontRay rays[];
+} rayQueues[2];
+
+// Hits of the shade queue, at the index of their ray
+layout(set = 0, binding = BINDING_WAVEFRONT_HITS, std430) buffer WavefrontHitBuffer {
+    WavefrontHit hits[];
+};
+
+// Indices of the hits ordered by their sort key
+layout(set = 0, binding = BINDING_WAVEFRONT_SORTED, std430) buffer WavefrontSortedBuffer {
+    uint sortedHits[];
+};
+
+layout(set = 0, binding = BINDING_WAVEFRONT_SHADOW_RAYS, std430) buffer WavefrontShadowRayBuffer {
+    WavefrontShadowRay shadowRays[];
+};
+
+layout(set = 0, binding = BINDING_WAVEFRONT_STATE, std430) buffer WavefrontStateBuffer {
+    WavefrontState state;
+};
+
+// Radiance gathered along the path of every pixel
+layout(set = 0, binding = BINDING_WAVEFRONT_RADIANCE, std430) buffer WavefrontRadianceBuffer {
+    vec4 radiance[];
+};
+
+// Index of the queue entry of a kernel dispatched indirectly with one dimensional work groups
+uint getQueueIndex() {
+    return gl_WorkGroupID.x * WAVEFRONT_GROUP_SIZE + gl_LocalInvocationIndex;
+}
+
+#endif
\ No newline at end of file
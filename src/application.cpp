@@ -5,38 +5,67 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <chrono>
+#include <future>
+#include <cstring>
 
 #include "vulkan/extensions.h"
+#include "vulkan/compute_permutations.h"
 
 const uint32_t BINDING_SCENE = 0;
 const uint32_t BINDING_OUTPUT = 1;
-const uint32_t BINDING_SETTINGS = 2;
+const uint32_t BINDING_ACCUMULATION = 2;
 const uint32_t BINDING_CAMERA = 3;
 const uint32_t BINDING_VERTEX_BUFFERS = 4;
 const uint32_t BINDING_INDEX_BUFFERS = 5;
 const uint32_t BINDING_SPHERE_BUFFERS = 6;
-const uint32_t BINDING_INSTANCE_BUFFERS = 7;
+const uint32_t BINDING_FRAME = 7;
 const uint32_t BINDING_MATERIAL_BUFFERS = 8;
 const uint32_t BINDING_TEXTURE_SAMPLERS = 9;
 const uint32_t BINDING_LIGHT_BUFFER = 10;
-
-struct SettingsUniforms {
-	uint32_t maxBounces;
-	float tmin;
-	float tmax;
-};
+const uint32_t BINDING_COLOR = 11;
+const uint32_t BINDING_MOTION = 12;
+const uint32_t BINDING_NORMAL_DEPTH = 13;
+const uint32_t BINDING_DENOISE = 14;
+const uint32_t BINDING_LIGHT_TREE = 15;
+const uint32_t BINDING_RESERVOIRS = 16;
+const uint32_t BINDING_WAVEFRONT_RAYS = 17;
+const uint32_t BINDING_WAVEFRONT_HITS = 18;
+const uint32_t BINDING_WAVEFRONT_SORTED = 19;
+const uint32_t BINDING_WAVEFRONT_SHADOW_RAYS = 20;
+const uint32_t BINDING_WAVEFRONT_STATE = 21;
+const uint32_t BINDING_WAVEFRONT_RADIANCE = 22;
+
+// Size of Reservoir in shaders/common/types.glsl
+const VkDeviceSize RESERVOIR_SIZE = 64;
 
 struct CameraUniforms {
 	glm::mat4 viewInverse;
 	glm::mat4 projInverse;
+	glm::mat4 prevViewProj;
+};
+
+struct FrameUniforms {
+	uint32_t index;
+	uint32_t accumulatedFrames;
+	uint32_t accumulationMode;
+	float exposure;
+	float whitePoint;
+	uint32_t maxHistory;
+	VkExtent2D extent;
+	uint32_t lightSampling;
 };
 
-struct LightUniforms {
-	glm::vec4 position;
-	glm::vec4 diffuseColor;
+struct AtrousPushConstants {
+	int32_t step;
+	uint32_t source;
+	uint32_t target;
+	float sigmaLuminance;
+	float sigmaNormal;
+	float sigmaDepth;
 };
 
 VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -72,23 +101,55 @@ void printExtensions(const std::string& type, const StringList& extensions) {
 	std::cout << std::endl;
 }
 
-Application::Application(const std::string& name, uint32_t width, uint32_t height)
-		: name(name), width(width), height(height) {
+Application::Application(const std::string& name, uint32_t width, uint32_t height,
+	const RenderSettings& renderSettings)
+		: name(name), width(width), height(height), renderSettings(renderSettings) {
 	createWindow();
 	createInstance();
 	createSurface();
 	createDevice();
 	createBuffers();
+	graphExecutor = new GraphExecutor(device);
+	createRenderTargets();
 	createScene();
+	createShaderWatcher();
+	createComputePipelines();
 	writeDescriptorSets();
+
+	traceTimer = new GpuTimer(device);
+
+	if (renderSettings.dynamicResolution) {
+		dynamicResolution = new DynamicResolution(renderSettings.minScale, renderSettings.scale, renderSettings.targetTraceTime);
+	}
 }
 
 Application::~Application() {
 
+	delete shaderWatcher;
+	delete dynamicResolution;
+	delete traceTimer;
+	delete tonemapPipeline;
+	delete tonemapShader;
+	delete temporalPipeline;
+	delete temporalShader;
+	delete atrousPipeline;
+	delete atrousShader;
+	delete variancePipeline;
+	delete varianceShader;
+	delete restirTemporalPipeline;
+	delete restirTemporalShader;
+	delete wavefront;
 	delete scene;
-	delete settingsUniformBuffer;
-	delete cameraUniformBuffer;
-	delete lightUniformBuffer;
+	destroyRenderTargets();
+	delete graphExecutor;
+	for (auto b : cameraUniformBuffers) {
+		delete b;
+	}
+
+	for (auto b : frameUniformBuffers) {
+		delete b;
+	}
+
 	delete device;
 	vkDestroySurfaceKHR(*instance, surface, nullptr);
 	delete instance;
@@ -101,6 +162,8 @@ void Application::update(float dt) {
 	// Update scene
 	auto id = glm::mat4(1.0f);
 
+	scene->beginFrame();
+
 	{
 		auto rotation = glm::rotate(id, dt * glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 		auto rotationSelf = glm::rotate(
@@ -112,8 +175,6 @@ void Application::update(float dt) {
 		scene->rotatingCube->transform = rotation * translation * rotationSelf;
 	}
 
-	LightUniforms light = {};
-
 	{
 		auto scale = glm::scale(id, glm::vec3(0.025f));
 		auto translation = glm::translate(id, glm::vec3(
@@ -123,52 +184,157 @@ void Application::update(float dt) {
 		);
 
 		scene->pointLight->transform = translation * scale;
-		light.position = scene->pointLight->transform * glm::vec4(0, 0, 0, 1);
+		scene->mainLight->position = scene->pointLight->transform * glm::vec4(0, 0, 0, 1);
 	}
 
-	lightUniformBuffer->fill(&light);
-
 	scene->updateInstance(scene->rotatingCube);
 	scene->updateInstance(scene->pointLight);
-	scene->buildAccelerationStructure(true);
+	scene->updateLight(scene->mainLight);
+	scene->buildLightTree();
 
 	// Update matrices
 	auto ext = device->getSwapchain()->getExtent();
 
-	CameraUniforms camera = {};
-	camera.viewInverse = glm::inverse(glm::lookAt(glm::vec3(5.0f, 5.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-	camera.projInverse = glm::inverse(glm::perspective(glm::radians(45.0f), ext.width / (float) ext.height, 0.1f, 10.0f));
-	camera.projInverse[1][1] *= -1;
+	auto view = glm::lookAt(glm::vec3(5.0f, 5.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	auto proj = glm::perspective(glm::radians(45.0f), ext.width / (float) ext.height, 0.1f, 10.0f);
+	proj[1][1] *= -1;
+
+	// Written to the camera uniforms of the frame once its slot is free
+	prevViewProj = (viewProj == glm::mat4(0.0f)) ? proj * view : viewProj;
+	viewProj = proj * view;
+	viewInverse = glm::inverse(view);
+	projInverse = glm::inverse(proj);
 
-	cameraUniformBuffer->fill(&camera);
+	// Progressive accumulation restarts whenever the camera or the scene changed, temporal accumulation
+	// follows the changes with motion vectors
+	bool changed = viewInverse != accumulationViewInverse || projInverse != accumulationProjInverse ||
+		scene->getRevision() != accumulationRevision;
+
+	accumulationViewInverse = viewInverse;
+	accumulationProjInverse = projInverse;
+	accumulationRevision = scene->getRevision();
+
+	if (accumulationMode == AccumulationMode::Off || (accumulationMode == AccumulationMode::Progressive && changed)) {
+		accumulatedFrames = 0;
+	}
 }
 
 void Application::run() {
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		scene->applyShaderReload();
 
 		static auto lastTime = std::chrono::high_resolution_clock::now();
 		auto currentTime = std::chrono::high_resolution_clock::now();
-		update(std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastTime).count());
+		float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastTime).count();
+		lastTime = currentTime;
+
+		if (!paused) {
+			animationTime += frameTime;
+		}
+
+		update(animationTime);
 
 		if (!device->frameBegin()) {
-			std::cout << "frameBegin() failed!" << std::endl;
+			recreateSwapchain();
 			continue;
 		}
 
-		updateRaytracingRenderTarget();
-		device->beginRenderPass();
+		// The top level structure is refitted into a secondary command buffer on a second thread, while this
+		// one prepares the frame
+		auto refit = std::async(std::launch::async, [this]() {
+			auto commandBuffer = device->beginSecondaryCommands(1);
+			scene->buildAccelerationStructure(true, commandBuffer);
+			device->endSecondaryCommands(commandBuffer);
+
+			return commandBuffer;
+		});
+
+		updateRenderScale();
+		updateFrameUniforms();
+
+		// Tracing and tonemapping run outside of a render pass, they only write storage images. Every pass
+		// declares the images and buffers it uses, the graph culls passes no output depends on and the
+		// executor places the barriers between the others
+		RenderGraph graph;
+		buildFrameGraph(graph, false);
+		graphExecutor->place(graph);
+		graph.compile();
 
-		scene->trace();
+		device->executeCommands({ refit.get() });
+
+		// The back buffer is only needed from the transfer on, the acquire semaphore is waited for at that stage
+		device->getTracker().import(device->getBackBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+		graphExecutor->execute(graph);
 
-		device->endRenderPass();
 		device->frameEnd();
-		device->framePresent();
+
+		// Not every platform reports a resized window as an out of date swapchain
+		if (!device->framePresent() || framebufferResized) {
+			recreateSwapchain();
+		}
+
+		frameCount++;
+		accumulatedFrames++;
 	}
 
 	vkDeviceWaitIdle(*device);
 }
 
+void Application::recreateSwapchain() {
+	framebufferResized = false;
+
+	// A minimized window has no size, wait until it is restored
+	int w = 0, h = 0;
+	glfwGetFramebufferSize(window, &w, &h);
+
+	while (w == 0 || h == 0) {
+		glfwWaitEvents();
+		glfwGetFramebufferSize(window, &w, &h);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	auto previousExtent = getRenderTargetExtent();
+
+	device->recreateSwapchain(w, h);
+	width = (uint32_t) w;
+	height = (uint32_t) h;
+
+	// The scene with its acceleration structures and pipelines does not depend on the window size, only
+	// the render targets and the buffers sized for them are replaced
+	auto extent = getRenderTargetExtent();
+
+	if (extent.width != previousExtent.width || extent.height != previousExtent.height) {
+		destroyRenderTargets();
+		createRenderTargets();
+		wavefront->resize(extent);
+		writeDescriptorSets();
+
+		// The history and the motion vectors do not match the new pixels
+		accumulatedFrames = 0;
+		viewProj = glm::mat4(0.0f);
+	}
+
+	float time = std::chrono::duration<float, std::chrono::milliseconds::period>(
+		std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "Swapchain recreated at " << w << "x" << h << " in " << time << " ms" << std::endl;
+}
+
+void Application::trace() {
+
+	// The wavefront kernels rely on the hit shaders of the path tracing pipeline variant
+	if (isWavefrontActive()) {
+		wavefront->trace(getRenderExtent(), scene->getSettings().maxBounces);
+	} else {
+		scene->trace(getRenderExtent());
+	}
+}
+
+bool Application::isWavefrontActive() const {
+	return scheduler == Scheduler::Wavefront && scene->getSettings().pathTracing;
+}
+
 void Application::queryExtensions() {
 	auto ext = instance->getExtensions();
 
@@ -198,13 +364,85 @@ StringList Application::getRequiredDeviceExtensions() {
 	return { VK_NV_RAY_TRACING_EXTENSION_NAME };
 }
 
+void Application::keyCallback(GLFWwindow* window, int key, int, int action, int) {
+	auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+
+	if (action != GLFW_PRESS) {
+		return;
+	}
+
+	switch (key) {
+		case GLFW_KEY_SPACE:
+			app->paused = !app->paused;
+			std::cout << "Animation " << (app->paused ? "paused" : "resumed") << std::endl;
+			break;
+
+		case GLFW_KEY_A: {
+			static const char* names[] = { "off", "progressive", "temporal" };
+
+			app->accumulationMode = (AccumulationMode) (((int) app->accumulationMode + 1) % _countof(names));
+			app->accumulatedFrames = 0;
+
+			std::cout << "Accumulation " << names[(int) app->accumulationMode] << std::endl;
+			break;
+		}
+
+		case GLFW_KEY_D:
+			app->denoiserEnabled = !app->denoiserEnabled;
+			std::cout << "Denoiser " << (app->denoiserEnabled ? "enabled" : "disabled") << std::endl;
+			break;
+
+		case GLFW_KEY_P: {
+			auto settings = app->scene->getSettings();
+			settings.pathTracing = !settings.pathTracing;
+			settings.maxBounces = settings.pathTracing ? app->pathTracingBounces : 1;
+
+			app->scene->setSettings(settings);
+			std::cout << (settings.pathTracing ? "Path tracing" : "Recursive ray tracing") << std::endl;
+			break;
+		}
+
+		case GLFW_KEY_W: {
+			std::cout << "Trace time " << app->traceTimer->getTime() << " ms" << std::endl;
+			app->scheduler = app->scheduler == Scheduler::Wavefront ? Scheduler::Megakernel : Scheduler::Wavefront;
+
+			// Both schedulers trace paths, switch to path tracing if necessary
+			auto settings = app->scene->getSettings();
+			if (app->scheduler == Scheduler::Wavefront && !settings.pathTracing) {
+				settings.pathTracing = true;
+				settings.maxBounces = app->pathTracingBounces;
+				app->scene->setSettings(settings);
+			}
+
+			std::cout << (app->scheduler == Scheduler::Wavefront ? "Wavefront" : "Megakernel") << " path tracing" << std::endl;
+			break;
+		}
+
+		case GLFW_KEY_L:
+			app->lightSampling = app->lightSampling == LightSampling::Restir ? LightSampling::Tree : LightSampling::Restir;
+			app->accumulatedFrames = 0;
+
+			std::cout << "Light sampling " << (app->lightSampling == LightSampling::Restir ? "ReSTIR" : "light tree") << std::endl;
+			break;
+	}
+}
+
+void Application::framebufferSizeCallback(GLFWwindow* window, int, int) {
+	auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+	app->framebufferResized = true;
+}
+
 void Application::createWindow() {
 	glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 	window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
+
+	glfwSetWindowUserPointer(window, this);
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 }
 
 void Application::createInstance() {
@@ -214,7 +452,22 @@ void Application::createInstance() {
 
 void Application::createDevice() {
 	device = instance->createDevice();
+	device->getTracker().setValidation(debug);
 	printExtensions("device", device->getExtensions());
+
+	std::cout << "Present mode " << SwapChain::getPresentModeName(device->getSwapchain()->getPresentMode()) << ", "
+		<< device->getSwapchain()->getImages().size() << " swapchain images, "
+		<< device->getFrameCount() << " frames in flight" << std::endl;
+
+	const char* queueNames[] = { "Graphics", "Compute", "Transfer" };
+
+	for (int i = 0; i < Device::QUEUE_TYPE_COUNT; i++) {
+		auto type = (Device::QueueType) i;
+
+		std::cout << queueNames[i] << " queue family " << device->getQueueFamily(type)
+			<< (type == Device::QueueType::Graphics || device->hasDedicatedQueue(type) ? "" : " (shared with graphics)")
+			<< std::endl;
+	}
 }
 
 void Application::createSurface() {
@@ -224,35 +477,160 @@ void Application::createSurface() {
 }
 
 void Application::createScene() {
-	scene = new Scene(device);
+	RaytracingPipeline::Settings settings;
+	settings.maxBounces = 1;
+	settings.tmin = 0.001f;
+	settings.tmax = 48.0f;
+	settings.samplesPerPixel = 1;
+
+	scene = new Scene(device, settings);
+
+	size_t submits, commandBuffers;
+	device->getSingleTimeStatistics(submits, commandBuffers);
+
+	std::cout << "Scene loaded with " << submits << " submits recorded into " << commandBuffers
+		<< " command buffers" << std::endl;
+}
+
+void Application::createShaderWatcher() {
+
+	// Builds without runtime shader compilation cannot reload
+#ifndef SHADER_ARCHIVE_ONLY
+	// Shaders are recompiled on the watcher thread, the scene swaps in the new pipeline between frames
+	shaderWatcher = new FileWatcher("shaders", [this](const std::vector<std::string>& files) {
+		scene->reloadShaders(files);
+	});
+#endif
 }
 
 void Application::createBuffers() {
 
-	{
-		settingsUniformBuffer = new Buffer(device, sizeof(SettingsUniforms),
+	for (size_t i = 0; i < device->getDescriptorSets().size(); i++) {
+		cameraUniformBuffers.push_back(new Buffer(device, sizeof(CameraUniforms),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+		frameUniformBuffers.push_back(new Buffer(device, sizeof(FrameUniforms),
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+	}
+}
+
+VkExtent2D Application::getRenderTargetExtent() const {
+	auto ext = device->getSwapchain()->getExtent();
+
+	VkExtent2D extent;
+	extent.width = std::max(1u, (uint32_t) (ext.width * renderSettings.scale));
+	extent.height = std::max(1u, (uint32_t) (ext.height * renderSettings.scale));
 
-		SettingsUniforms settings;
-		settings.maxBounces = 1;
-		settings.tmin = 0.001f;
-		settings.tmax = 48.0f;
+	return extent;
+}
 
-		settingsUniformBuffer->fill(&settings);
+VkExtent2D Application::getRenderExtent() const {
+	if (!dynamicResolution) {
+		return getRenderTargetExtent();
 	}
 
-	{
-		cameraUniformBuffer = new Buffer(device, sizeof(CameraUniforms),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	auto ext = device->getSwapchain()->getExtent();
+	auto max = getRenderTargetExtent();
+
+	VkExtent2D extent;
+	extent.width = std::clamp((uint32_t) (ext.width * dynamicResolution->getScale()), 1u, max.width);
+	extent.height = std::clamp((uint32_t) (ext.height * dynamicResolution->getScale()), 1u, max.height);
+
+	return extent;
+}
+
+void Application::createRenderTargets() {
+	if (renderSettings.format != VK_FORMAT_R8G8B8A8_UNORM && renderSettings.format != VK_FORMAT_R16G16B16A16_SFLOAT) {
+		throw std::logic_error("Render target format has to be R8G8B8A8_UNORM or R16G16B16A16_SFLOAT");
 	}
 
-	{
-		lightUniformBuffer = new Buffer(device, sizeof(LightUniforms),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	// Images only used within a frame are transient, the frame graph places them in shared memory below
+	colorImage = new Image(device, getRenderTargetExtent(),
+		VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+
+	motionImage = new Image(device, getRenderTargetExtent(),
+		VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+
+	for (auto& image : accumulationImages) {
+		image = new Image(device, getRenderTargetExtent(),
+			VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT);
+	}
+
+	normalDepthImage = new Image(device, getRenderTargetExtent(),
+		VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+
+	for (auto& image : denoiseImages) {
+		image = new Image(device, getRenderTargetExtent(),
+			VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+	}
+
+	outputImage = new Image(device, getRenderTargetExtent(), renderSettings.format,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+
+	auto extent = getRenderTargetExtent();
+	VkCommandBuffer commandBuffer = device->beginSingleTimeCommands();
+
+	// Cleared, so the first frame finds no valid history
+	for (auto& buffer : reservoirBuffers) {
+		buffer = new Buffer(device, extent.width * extent.height * RESERVOIR_SIZE,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		vkCmdFillBuffer(commandBuffer, *buffer, 0, VK_WHOLE_SIZE, 0);
+	}
+
+	device->endSingleTimeCommands(commandBuffer);
+
+	// Placed for the graph with every optional pass, the frames only use part of it
+	RenderGraph graph;
+	buildFrameGraph(graph, true);
+	graph.compile();
+	graphExecutor->allocate(graph);
+
+	VkDeviceSize separateSize = 0;
+
+	for (auto image : { colorImage, motionImage, normalDepthImage, denoiseImages[0], denoiseImages[1], outputImage }) {
+		separateSize += image->getMemoryRequirements().size;
 	}
+
+	std::cout << "Transient render targets share " << (graphExecutor->getTransientSize() >> 20) << " MB instead of "
+		<< (separateSize >> 20) << " MB" << std::endl;
+}
+
+void Application::destroyRenderTargets() {
+	delete colorImage;
+	delete motionImage;
+	delete accumulationImages[0];
+	delete accumulationImages[1];
+	delete normalDepthImage;
+	delete denoiseImages[0];
+	delete denoiseImages[1];
+	delete outputImage;
+	delete reservoirBuffers[0];
+	delete reservoirBuffers[1];
+}
+
+void Application::createComputePipelines() {
+	auto defines = getTonemapDefines(renderSettings.format == VK_FORMAT_R16G16B16A16_SFLOAT);
+
+	tonemapShader = Shader::loadFromFile(device, "shaders/tonemap.comp", Shader::Type::Compute, defines);
+	tonemapPipeline = new ComputePipeline(device, tonemapShader, sizeof(int32_t));
+
+	temporalShader = Shader::loadFromFile(device, "shaders/temporal.comp", Shader::Type::Compute);
+	temporalPipeline = new ComputePipeline(device, temporalShader);
+
+	varianceShader = Shader::loadFromFile(device, "shaders/variance.comp", Shader::Type::Compute);
+	variancePipeline = new ComputePipeline(device, varianceShader);
+
+	atrousShader = Shader::loadFromFile(device, "shaders/atrous.comp", Shader::Type::Compute);
+	atrousPipeline = new ComputePipeline(device, atrousShader, sizeof(AtrousPushConstants));
+
+	restirTemporalShader = Shader::loadFromFile(device, "shaders/restir_temporal.comp", Shader::Type::Compute);
+	restirTemporalPipeline = new ComputePipeline(device, restirTemporalShader);
+
+	wavefront = new WavefrontScheduler(device, scene, getRenderTargetExtent());
 }
 
 VkDescriptorSetLayoutCreateInfo Application::getDescriptorSetLayoutInfo() {
@@ -278,19 +656,67 @@ VkDescriptorSetLayoutCreateInfo Application::getDescriptorSetLayoutInfo() {
 		b.descriptorCount = 1;
 		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings.push_back(b);
+	}
+
+	// Accumulation images
+	{
+		VkDescriptorSetLayoutBinding b = {};
+		b.binding = BINDING_ACCUMULATION;
+		b.descriptorCount = _countof(accumulationImages);
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		b.pImmutableSamplers = nullptr;
+		b.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 		bindings.push_back(b);
 	}
 
-	// Settings uniform buffer
+	// Color image
 	{
 		VkDescriptorSetLayoutBinding b = {};
-		b.binding = BINDING_SETTINGS;
+		b.binding = BINDING_COLOR;
 		b.descriptorCount = 1;
-		b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings.push_back(b);
+	}
+
+	// Motion vector image
+	{
+		VkDescriptorSetLayoutBinding b = {};
+		b.binding = BINDING_MOTION;
+		b.descriptorCount = 1;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		b.pImmutableSamplers = nullptr;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings.push_back(b);
+	}
+
+	// Normal and depth image
+	{
+		VkDescriptorSetLayoutBinding b = {};
+		b.binding = BINDING_NORMAL_DEPTH;
+		b.descriptorCount = 1;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		b.pImmutableSamplers = nullptr;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings.push_back(b);
+	}
+
+	// Denoise images
+	{
+		VkDescriptorSetLayoutBinding b = {};
+		b.binding = BINDING_DENOISE;
+		b.descriptorCount = _countof(denoiseImages);
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		b.pImmutableSamplers = nullptr;
+		b.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 		bindings.push_back(b);
 	}
@@ -302,51 +728,51 @@ VkDescriptorSetLayoutCreateInfo Application::getDescriptorSetLayoutInfo() {
 		b.descriptorCount = 1;
 		b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
 
 		bindings.push_back(b);
 	}
 
-	// Vertex buffer
+	// Frame uniform buffer
 	{
 		VkDescriptorSetLayoutBinding b = {};
-		b.binding = BINDING_VERTEX_BUFFERS;
-		b.descriptorCount = 32;
-		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		b.binding = BINDING_FRAME;
+		b.descriptorCount = 1;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
 
 		bindings.push_back(b);
 	}
 
-	// Index buffer
+	// Vertex buffer
 	{
 		VkDescriptorSetLayoutBinding b = {};
-		b.binding = BINDING_INDEX_BUFFERS;
+		b.binding = BINDING_VERTEX_BUFFERS;
 		b.descriptorCount = 32;
 		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_ANY_HIT_BIT_NV;
 
 		bindings.push_back(b);
 	}
 
-	// Sphere buffer
+	// Index buffer
 	{
 		VkDescriptorSetLayoutBinding b = {};
-		b.binding = BINDING_SPHERE_BUFFERS;
+		b.binding = BINDING_INDEX_BUFFERS;
 		b.descriptorCount = 32;
 		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_INTERSECTION_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_ANY_HIT_BIT_NV;
 
 		bindings.push_back(b);
 	}
 
-	// Instances
+	// Sphere buffer
 	{
 		VkDescriptorSetLayoutBinding b = {};
-		b.binding = BINDING_INSTANCE_BUFFERS;
+		b.binding = BINDING_SPHERE_BUFFERS;
 		b.descriptorCount = 32;
 		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		b.pImmutableSamplers = nullptr;
@@ -374,19 +800,56 @@ VkDescriptorSetLayoutCreateInfo Application::getDescriptorSetLayoutInfo() {
 		b.descriptorCount = 32;
 		b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_ANY_HIT_BIT_NV;
 
 		bindings.push_back(b);
 	}
 
-	// Light uniform buffer
+	// Lights
 	{
 		VkDescriptorSetLayoutBinding b = {};
 		b.binding = BINDING_LIGHT_BUFFER;
 		b.descriptorCount = 1;
-		b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		b.pImmutableSamplers = nullptr;
-		b.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings.push_back(b);
+	}
+
+	// Light tree
+	{
+		VkDescriptorSetLayoutBinding b = {};
+		b.binding = BINDING_LIGHT_TREE;
+		b.descriptorCount = 1;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		b.pImmutableSamplers = nullptr;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings.push_back(b);
+	}
+
+	// ReSTIR reservoirs
+	{
+		VkDescriptorSetLayoutBinding b = {};
+		b.binding = BINDING_RESERVOIRS;
+		b.descriptorCount = 2;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		b.pImmutableSamplers = nullptr;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings.push_back(b);
+	}
+
+	// Queues of the wavefront path tracer, the ray queues are ping-ponged between bounces
+	for (auto binding : { BINDING_WAVEFRONT_RAYS, BINDING_WAVEFRONT_HITS, BINDING_WAVEFRONT_SORTED,
+		BINDING_WAVEFRONT_SHADOW_RAYS, BINDING_WAVEFRONT_STATE, BINDING_WAVEFRONT_RADIANCE }) {
+		VkDescriptorSetLayoutBinding b = {};
+		b.binding = binding;
+		b.descriptorCount = binding == BINDING_WAVEFRONT_RAYS ? 2 : 1;
+		b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		b.pImmutableSamplers = nullptr;
+		b.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_COMPUTE_BIT;
 
 		bindings.push_back(b);
 	}
@@ -401,7 +864,11 @@ VkDescriptorSetLayoutCreateInfo Application::getDescriptorSetLayoutInfo() {
 
 void Application::writeDescriptorSets() {
 
-	for (const auto& ds : device->getDescriptorSets()) {
+	auto descriptorSets = device->getDescriptorSets();
+
+	for (size_t frame = 0; frame < descriptorSets.size(); frame++) {
+		const auto& ds = descriptorSets[frame];
+
 		{
 			VkAccelerationStructureNV as = *scene->getAccelerationStructure();
 
@@ -422,26 +889,9 @@ void Application::writeDescriptorSets() {
 		}
 
 		{
+			// The camera moves every frame, each frame in flight reads its own camera uniforms
 			VkDescriptorBufferInfo info = {};
-			info.buffer = *settingsUniformBuffer;
-			info.offset = 0;
-			info.range = VK_WHOLE_SIZE;
-
-			VkWriteDescriptorSet wds = {};
-			wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			wds.dstSet = ds;
-			wds.dstArrayElement = 0;
-			wds.descriptorCount = 1;
-			wds.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			wds.dstBinding = BINDING_SETTINGS;
-			wds.pBufferInfo = &info;
-
-			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
-		}
-
-		{
-			VkDescriptorBufferInfo info = {};
-			info.buffer = *cameraUniformBuffer;
+			info.buffer = *cameraUniformBuffers[frame];
 			info.offset = 0;
 			info.range = VK_WHOLE_SIZE;
 
@@ -533,9 +983,9 @@ void Application::writeDescriptorSets() {
 		{
 			std::vector<VkDescriptorBufferInfo> info;
 
-			for (const auto& o : scene->getInstances()) {
+			for (const auto& m : scene->getMaterials()) {
 				VkDescriptorBufferInfo i = {};
-				i.buffer = *o->buffer;
+				i.buffer = *m->buffer;
 				i.offset = 0;
 				i.range = VK_WHOLE_SIZE;
 
@@ -548,18 +998,70 @@ void Application::writeDescriptorSets() {
 			wds.dstArrayElement = 0;
 			wds.descriptorCount = (uint32_t) info.size();
 			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			wds.dstBinding = BINDING_INSTANCE_BUFFERS;
+			wds.dstBinding = BINDING_MATERIAL_BUFFERS;
 			wds.pBufferInfo = info.data();
 
 			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
 		}
 
+		{
+			std::vector<VkDescriptorImageInfo> info;
+
+			for (const auto& t : scene->getTextures()) {
+				VkDescriptorImageInfo i = {};
+				i.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				i.imageView = t->getImageView();
+				i.sampler = t->getSampler();
+
+				info.push_back(i);
+			}
+
+			VkWriteDescriptorSet wds = {};
+			wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			wds.dstSet = ds;
+			wds.dstArrayElement = 0;
+			wds.descriptorCount = (uint32_t) info.size();
+			wds.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			wds.dstBinding = BINDING_TEXTURE_SAMPLERS;
+			wds.pImageInfo = info.data();
+
+			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
+		}
+
+		{
+			VkDescriptorBufferInfo info[2] = {};
+			// Each frame in flight reads its own copy of the lights
+			info[0].buffer = *scene->getLightBuffer((uint32_t) frame);
+			info[0].offset = 0;
+			info[0].range = VK_WHOLE_SIZE;
+
+			info[1].buffer = *scene->getLightTreeBuffer((uint32_t) frame);
+			info[1].offset = 0;
+			info[1].range = VK_WHOLE_SIZE;
+
+			VkWriteDescriptorSet wds[2] = {};
+
+			for (int i = 0; i < 2; i++) {
+				wds[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				wds[i].dstSet = ds;
+				wds[i].dstArrayElement = 0;
+				wds[i].descriptorCount = 1;
+				wds[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				wds[i].pBufferInfo = &info[i];
+			}
+
+			wds[0].dstBinding = BINDING_LIGHT_BUFFER;
+			wds[1].dstBinding = BINDING_LIGHT_TREE;
+
+			vkUpdateDescriptorSets(*device, 2, wds, 0, nullptr);
+		}
+
 		{
 			std::vector<VkDescriptorBufferInfo> info;
 
-			for (const auto& m : scene->getMaterials()) {
+			for (auto buffer : reservoirBuffers) {
 				VkDescriptorBufferInfo i = {};
-				i.buffer = *m->buffer;
+				i.buffer = *buffer;
 				i.offset = 0;
 				i.range = VK_WHOLE_SIZE;
 
@@ -572,20 +1074,73 @@ void Application::writeDescriptorSets() {
 			wds.dstArrayElement = 0;
 			wds.descriptorCount = (uint32_t) info.size();
 			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			wds.dstBinding = BINDING_MATERIAL_BUFFERS;
+			wds.dstBinding = BINDING_RESERVOIRS;
 			wds.pBufferInfo = info.data();
 
 			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
 		}
 
+		{
+			std::vector<std::pair<uint32_t, std::vector<Buffer*>>> queues = {
+				{ BINDING_WAVEFRONT_RAYS, { wavefront->getRayBuffers()[0], wavefront->getRayBuffers()[1] } },
+				{ BINDING_WAVEFRONT_HITS, { wavefront->getHitBuffer() } },
+				{ BINDING_WAVEFRONT_SORTED, { wavefront->getSortedBuffer() } },
+				{ BINDING_WAVEFRONT_SHADOW_RAYS, { wavefront->getShadowRayBuffer() } },
+				{ BINDING_WAVEFRONT_STATE, { wavefront->getStateBuffer() } },
+				{ BINDING_WAVEFRONT_RADIANCE, { wavefront->getRadianceBuffer() } }
+			};
+
+			for (const auto& queue : queues) {
+				std::vector<VkDescriptorBufferInfo> info;
+
+				for (auto buffer : queue.second) {
+					VkDescriptorBufferInfo i = {};
+					i.buffer = *buffer;
+					i.offset = 0;
+					i.range = VK_WHOLE_SIZE;
+
+					info.push_back(i);
+				}
+
+				VkWriteDescriptorSet wds = {};
+				wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				wds.dstSet = ds;
+				wds.dstArrayElement = 0;
+				wds.descriptorCount = (uint32_t) info.size();
+				wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				wds.dstBinding = queue.first;
+				wds.pBufferInfo = info.data();
+
+				vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
+			}
+		}
+
+		{
+			VkDescriptorImageInfo info = {};
+			info.imageView = outputImage->getImageView();
+			info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			info.sampler = VK_NULL_HANDLE;
+
+			VkWriteDescriptorSet wds = {};
+			wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			wds.dstSet = ds;
+			wds.dstArrayElement = 0;
+			wds.descriptorCount = 1;
+			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			wds.dstBinding = BINDING_OUTPUT;
+			wds.pImageInfo = &info;
+
+			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
+		}
+
 		{
 			std::vector<VkDescriptorImageInfo> info;
 
-			for (const auto& t : scene->getTextures()) {
+			for (auto image : accumulationImages) {
 				VkDescriptorImageInfo i = {};
-				i.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				i.imageView = t->getImageView();
-				i.sampler = t->getSampler();
+				i.imageView = image->getImageView();
+				i.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+				i.sampler = VK_NULL_HANDLE;
 
 				info.push_back(i);
 			}
@@ -595,16 +1150,95 @@ void Application::writeDescriptorSets() {
 			wds.dstSet = ds;
 			wds.dstArrayElement = 0;
 			wds.descriptorCount = (uint32_t) info.size();
-			wds.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			wds.dstBinding = BINDING_TEXTURE_SAMPLERS;
+			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			wds.dstBinding = BINDING_ACCUMULATION;
+			wds.pImageInfo = info.data();
+
+			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
+		}
+
+		{
+			VkDescriptorImageInfo info = {};
+			info.imageView = colorImage->getImageView();
+			info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			info.sampler = VK_NULL_HANDLE;
+
+			VkWriteDescriptorSet wds = {};
+			wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			wds.dstSet = ds;
+			wds.dstArrayElement = 0;
+			wds.descriptorCount = 1;
+			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			wds.dstBinding = BINDING_COLOR;
+			wds.pImageInfo = &info;
+
+			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
+		}
+
+		{
+			VkDescriptorImageInfo info = {};
+			info.imageView = motionImage->getImageView();
+			info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			info.sampler = VK_NULL_HANDLE;
+
+			VkWriteDescriptorSet wds = {};
+			wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			wds.dstSet = ds;
+			wds.dstArrayElement = 0;
+			wds.descriptorCount = 1;
+			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			wds.dstBinding = BINDING_MOTION;
+			wds.pImageInfo = &info;
+
+			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
+		}
+
+		{
+			VkDescriptorImageInfo info = {};
+			info.imageView = normalDepthImage->getImageView();
+			info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			info.sampler = VK_NULL_HANDLE;
+
+			VkWriteDescriptorSet wds = {};
+			wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			wds.dstSet = ds;
+			wds.dstArrayElement = 0;
+			wds.descriptorCount = 1;
+			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			wds.dstBinding = BINDING_NORMAL_DEPTH;
+			wds.pImageInfo = &info;
+
+			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
+		}
+
+		{
+			std::vector<VkDescriptorImageInfo> info;
+
+			for (auto image : denoiseImages) {
+				VkDescriptorImageInfo i = {};
+				i.imageView = image->getImageView();
+				i.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+				i.sampler = VK_NULL_HANDLE;
+
+				info.push_back(i);
+			}
+
+			VkWriteDescriptorSet wds = {};
+			wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			wds.dstSet = ds;
+			wds.dstArrayElement = 0;
+			wds.descriptorCount = (uint32_t) info.size();
+			wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			wds.dstBinding = BINDING_DENOISE;
 			wds.pImageInfo = info.data();
 
 			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
 		}
 
 		{
+			// Each frame in flight reads its own frame uniforms
 			VkDescriptorBufferInfo info = {};
-			info.buffer = *lightUniformBuffer;
+			info.buffer = *frameUniformBuffers[frame];
 			info.offset = 0;
 			info.range = VK_WHOLE_SIZE;
 
@@ -614,7 +1248,7 @@ void Application::writeDescriptorSets() {
 			wds.dstArrayElement = 0;
 			wds.descriptorCount = 1;
 			wds.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			wds.dstBinding = BINDING_LIGHT_BUFFER;
+			wds.dstBinding = BINDING_FRAME;
 			wds.pBufferInfo = &info;
 
 			vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
@@ -622,24 +1256,233 @@ void Application::writeDescriptorSets() {
 	}
 }
 
-void Application::updateRaytracingRenderTarget() {
+void Application::updateRenderScale() {
+	float time = traceTimer->getTime();
+
+	// Pixels no longer match the accumulated ones at another resolution
+	if (dynamicResolution && dynamicResolution->update(time)) {
+		accumulatedFrames = 0;
+	}
+}
+
+void Application::updateFrameUniforms() {
+	FrameUniforms frame = {};
+	frame.index = frameCount;
+	frame.accumulatedFrames = accumulatedFrames;
+	frame.accumulationMode = (uint32_t) accumulationMode;
+	frame.exposure = exposure;
+	frame.whitePoint = whitePoint;
+	frame.maxHistory = maxHistory;
+	frame.extent = getRenderExtent();
+	frame.lightSampling = (uint32_t) lightSampling;
+
+	frameUniformBuffers[device->getFrameIndex()]->fill(&frame);
+
+	CameraUniforms camera = {};
+	camera.viewInverse = viewInverse;
+	camera.projInverse = projInverse;
+	camera.prevViewProj = prevViewProj;
+
+	cameraUniformBuffers[device->getFrameIndex()]->fill(&camera);
+
+	scene->writeLightBuffers();
+}
+
+void Application::buildFrameGraph(RenderGraph& graph, bool allPasses) {
+	auto usage = [](VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL) {
+		RenderGraph::Usage usage;
+		usage.stages = stages;
+		usage.access = access;
+		usage.layout = (uint32_t) layout;
+		return usage;
+	};
+
+	auto rayTracingRead = usage(VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV, VK_ACCESS_SHADER_READ_BIT);
+	auto rayTracingWrite = usage(VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV, VK_ACCESS_SHADER_WRITE_BIT);
+	auto computeRead = usage(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	auto computeWrite = usage(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+	auto addImage = [&](const char* name, Image* image, bool transient) {
+		auto& requirements = image->getMemoryRequirements();
+		uint32_t resource = graph.addResource(name, transient, requirements.size, requirements.alignment);
+		graphExecutor->setImage(resource, image);
+		return resource;
+	};
+
+	auto addBuffer = [&](const char* name, Buffer* buffer) {
+		uint32_t resource = graph.addResource(name);
+		graphExecutor->setBuffer(resource, *buffer);
+		return resource;
+	};
+
+	// Resources are added in the same order by every frame, so their indices match the allocated graph
+	uint32_t color = addImage("color", colorImage, true);
+	uint32_t motion = addImage("motion", motionImage, true);
+	uint32_t normalDepth = addImage("normal depth", normalDepthImage, true);
+	uint32_t denoise[2] = { addImage("denoise 0", denoiseImages[0], true), addImage("denoise 1", denoiseImages[1], true) };
+	uint32_t output = addImage("output", outputImage, true);
+	uint32_t accumulation = addImage("accumulation", accumulationImages[frameCount % 2], false);
+	uint32_t accumulationHistory = addImage("accumulation history", accumulationImages[(frameCount + 1) % 2], false);
+	uint32_t reservoirs = addBuffer("reservoirs", reservoirBuffers[0]);
+	uint32_t reservoirHistory = addBuffer("reservoir history", reservoirBuffers[1]);
+
+	// Only acquired while a frame is recorded
+	uint32_t backBuffer = graph.addResource("back buffer");
+
+	if (!allPasses) {
+		graphExecutor->setImage(backBuffer, device->getBackBuffer());
+	}
+
+	// Read by the next frame or presented
+	graph.setOutput(accumulation);
+	graph.setOutput(reservoirHistory);
+	graph.setOutput(backBuffer);
+
+	bool wavefrontActive = !allPasses && isWavefrontActive();
+
+	// ReSTIR resolves the direct light of the primary hits, which the wavefront kernels sample themselves
+	bool restir = allPasses || (lightSampling == LightSampling::Restir && !wavefrontActive);
+
+	uint32_t trace = graph.addPass("trace", [this, restir]() {
+		traceTimer->begin();
+		this->trace();
+
+		if (!restir) {
+			traceTimer->end();
+		}
+	});
+
+	graph.write(trace, motion, rayTracingWrite);
+	graph.write(trace, normalDepth, rayTracingWrite);
+
+	if (wavefrontActive) {
+		graph.write(trace, color, computeWrite);
+	} else {
+		graph.write(trace, color, rayTracingWrite);
+	}
+
+	if (restir) {
+		graph.write(trace, reservoirs, rayTracingWrite);
+
+		// Temporal reuse merges the reservoirs of the primary hits with the history of the previous frame
+		uint32_t temporal = graph.addPass("restir temporal", [this]() {
+			restirTemporalPipeline->dispatch(getRenderExtent());
+		});
+
+		graph.read(temporal, reservoirs, computeRead);
+		graph.write(temporal, reservoirs, computeWrite);
+		graph.read(temporal, reservoirHistory, computeRead);
+		graph.read(temporal, motion, computeRead);
+
+		// Spatial reuse reads the resampled reservoirs, writes the history of the next frame and adds to the traced color
+		uint32_t spatial = graph.addPass("restir spatial", [this]() {
+			scene->trace(getRenderExtent(), Scene::RayGen::LightResampling);
+			traceTimer->end();
+		});
+
+		graph.read(spatial, reservoirs, rayTracingRead);
+		graph.write(spatial, reservoirHistory, rayTracingWrite);
+		graph.read(spatial, color, rayTracingRead);
+		graph.write(spatial, color, rayTracingWrite);
+	}
+
+	// Blends the traced image with the history of the previous frames
+	uint32_t accumulate = graph.addPass("accumulate", [this]() {
+		temporalPipeline->dispatch(getRenderExtent());
+	});
+
+	graph.read(accumulate, color, computeRead);
+	graph.read(accumulate, motion, computeRead);
+	graph.read(accumulate, accumulationHistory, computeRead);
+	graph.write(accumulate, accumulation, computeWrite);
+
+	// The denoiser passes are always added, they are culled if the tonemapper does not read their result
+	uint32_t iterations = allPasses ? std::max(denoiseSettings.iterations, 1u) : denoiseSettings.iterations;
+
+	if (iterations > 0) {
+		uint32_t variance = graph.addPass("variance", [this]() {
+			variancePipeline->dispatch(getRenderExtent());
+		});
+
+		graph.read(variance, accumulation, computeRead);
+		graph.read(variance, normalDepth, computeRead);
+		graph.write(variance, denoise[0], computeWrite);
+	}
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		uint32_t atrous = graph.addPass("atrous " + std::to_string(i), [this, i]() {
+			denoiseIteration(i);
+		});
+
+		graph.read(atrous, denoise[i % 2], computeRead);
+		graph.write(atrous, denoise[(i + 1) % 2], computeWrite);
+		graph.read(atrous, normalDepth, computeRead);
+	}
 
-	device->imageBarrier(device->getCommandBuffer(), device->getBackBuffer(),
-		0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	int denoiseImage = denoiserEnabled && iterations > 0 ? (int) (iterations % 2) : -1;
 
-	VkDescriptorImageInfo info;
-	info.imageView = device->getBackBufferView();
-	info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	info.sampler = VK_NULL_HANDLE;
+	uint32_t tonemap = graph.addPass("tonemap", [this, denoiseImage]() {
+		this->tonemap(denoiseImage);
+	});
 
-	VkWriteDescriptorSet wds = {};
-	wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	wds.dstSet = device->getDescriptorSet();
-	wds.dstArrayElement = 0;
-	wds.descriptorCount = 1;
-	wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-	wds.dstBinding = 1;
-	wds.pImageInfo = &info;
+	// Reading every possible source keeps the denoise images alive until the tonemapper in the allocated graph
+	if (allPasses) {
+		graph.read(tonemap, denoise[0], computeRead);
+		graph.read(tonemap, denoise[1], computeRead);
+	}
+
+	graph.read(tonemap, denoiseImage < 0 ? accumulation : denoise[denoiseImage], computeRead);
+	graph.write(tonemap, output, computeWrite);
+
+	// The output image stays in the general layout, which blits can read from
+	uint32_t blit = graph.addPass("blit", [this]() {
+		blitToBackBuffer();
+	});
+
+	graph.read(blit, output, usage(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+	graph.write(blit, backBuffer, usage(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+
+	// Presentation is ordered by the semaphore signaled after the submission, no access to wait for. The
+	// transition keeps the contents, so the pass reads them as well
+	auto presentUsage = usage(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	uint32_t present = graph.addPass("present");
+	graph.read(present, backBuffer, presentUsage);
+	graph.write(present, backBuffer, presentUsage);
+}
 
-	vkUpdateDescriptorSets(*device, 1, &wds, 0, nullptr);
-}
\ No newline at end of file
+void Application::denoiseIteration(uint32_t iteration) {
+	AtrousPushConstants constants = {};
+	constants.step = 1 << iteration;
+	constants.source = iteration % 2;
+	constants.target = (iteration + 1) % 2;
+	constants.sigmaLuminance = denoiseSettings.sigmaLuminance;
+	constants.sigmaNormal = denoiseSettings.sigmaNormal;
+	constants.sigmaDepth = denoiseSettings.sigmaDepth;
+
+	atrousPipeline->dispatch(getRenderExtent(), &constants);
+}
+
+void Application::tonemap(int denoiseImage) {
+	int32_t constants = denoiseImage;
+	tonemapPipeline->dispatch(getRenderExtent(), &constants);
+}
+
+void Application::blitToBackBuffer() {
+	auto src = getRenderExtent();
+	auto dst = device->getSwapchain()->getExtent();
+
+	// Blitting converts the format and scales with linear filtering if the render scale is not 1
+	VkImageBlit region = {};
+	region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.srcSubresource.layerCount = 1;
+	region.srcOffsets[1] = { (int32_t) src.width, (int32_t) src.height, 1 };
+	region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.dstSubresource.layerCount = 1;
+	region.dstOffsets[1] = { (int32_t) dst.width, (int32_t) dst.height, 1 };
+
+	vkCmdBlitImage(device->getCommandBuffer(),
+		*outputImage, VK_IMAGE_LAYOUT_GENERAL,
+		device->getBackBuffer(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &region, VK_FILTER_LINEAR);
+}
@@ -11,13 +11,42 @@
 #include "vulkan/vertex.h"
 #include "vulkan/scene.h"
 #include "vulkan/texture.h"
+#include "vulkan/image.h"
+#include "vulkan/compute_pipeline.h"
+#include "vulkan/gpu_timer.h"
+#include "vulkan/wavefront_scheduler.h"
+#include "vulkan/graph_executor.h"
 #include "vulkan/rt/raytracing_pipeline.h"
 #include "vulkan/rt/shader_binding_table.h"
+#include "file_watcher.h"
+#include "dynamic_resolution.h"
+#include "atrous_filter.h"
+#include "render_graph.h"
 
 class Application {
 	public:
 
-		Application(const std::string& name, uint32_t width, uint32_t height);
+		// The ray tracer renders into its own images, which are scaled to the window when presenting
+		struct RenderSettings {
+			// Resolution of the render targets relative to the window, the upper bound with dynamic resolution
+			float scale = 1.0f;
+
+			// Lowers the resolution down to minScale while tracing takes longer than targetTraceTime (ms)
+			bool dynamicResolution = false;
+
+			float minScale = 0.5f;
+
+			float targetTraceTime = 8.0f;
+
+			// Format of the tonemapped image, VK_FORMAT_R16G16B16A16_SFLOAT skips the tonemap curve and keeps HDR values
+			VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+			// Frames in flight and present mode of the swapchain
+			Device::Settings device;
+		};
+
+		Application(const std::string& name, uint32_t width, uint32_t height,
+			const RenderSettings& renderSettings = RenderSettings());
 
 		~Application();
 
@@ -41,8 +70,20 @@ class Application {
 
 		VkDescriptorSetLayoutCreateInfo getDescriptorSetLayoutInfo();
 
+		const Device::Settings& getDeviceSettings() const { return renderSettings.device; }
+
+		// Size of the render targets, the ray tracer might only use part of them
+		VkExtent2D getRenderTargetExtent() const;
+
+		// Size of the traced image at the current render scale
+		VkExtent2D getRenderExtent() const;
+
 	private:
 
+		static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+		static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
+
 		void createWindow();
 
 		void createInstance();
@@ -53,11 +94,46 @@ class Application {
 
 		void createScene();
 
+		void createShaderWatcher();
+
 		void createBuffers();
 
+		void createRenderTargets();
+
+		void destroyRenderTargets();
+
+		// Replaces the swapchain after a resize, and the render targets if their size changed. The scene
+		// and the pipelines are kept
+		void recreateSwapchain();
+
+		void createComputePipelines();
+
 		void writeDescriptorSets();
 
-		void updateRaytracingRenderTarget();
+		// Writes the camera and frame uniforms and the lights of the current frame, once frameBegin() waited for its slot
+		void updateFrameUniforms();
+
+		// Adapts the render scale to the trace time measured the last time this frame was recorded
+		void updateRenderScale();
+
+		// Adds the passes of a frame and the resources they use. With allPasses, the graph contains every
+		// pass that may run and is only compiled for placing the transient render targets
+		void buildFrameGraph(RenderGraph& graph, bool allPasses);
+
+		// Whether paths are traced by the wavefront kernels instead of primary.rgen
+		bool isWavefrontActive() const;
+
+		// Traces the color, motion and normal depth images with the selected scheduler
+		void trace();
+
+		// Filter pass of the denoiser, reading one of its images and writing the other
+		void denoiseIteration(uint32_t iteration);
+
+		// Resolves the accumulated or denoised radiance into the output image, denoiseImage is -1 without denoiser
+		void tonemap(int denoiseImage);
+
+		// Scales the output image to the back buffer
+		void blitToBackBuffer();
 
 		void queryExtensions();
 
@@ -71,8 +147,13 @@ class Application {
 
 		std::string name;
 
+		RenderSettings renderSettings;
+
 		GLFWwindow* window = nullptr;
 
+		// Set by the framebuffer size callback, the swapchain is recreated after the next present
+		bool framebufferResized = false;
+
 		Instance* instance = nullptr;
 
 		Device* device = nullptr;
@@ -81,11 +162,129 @@ class Application {
 
 		Scene* scene = nullptr;
 
-		Buffer* cameraUniformBuffer = nullptr;
+		FileWatcher* shaderWatcher = nullptr;
+
+		// One per frame in flight, since they change every frame
+		std::vector<Buffer*> cameraUniformBuffers;
+
+		std::vector<Buffer*> frameUniformBuffers;
+
+		// Radiance of the current frame and its motion to the previous frame, written by the ray tracer
+		Image* colorImage = nullptr;
+
+		Image* motionImage = nullptr;
+
+		// Radiance averaged over the history, each frame reads the one of the previous frame and writes the other
+		Image* accumulationImages[2] = { nullptr };
+
+		// G-buffer of the primary hits guiding the denoiser, world space normal and hit distance
+		Image* normalDepthImage = nullptr;
+
+		// Ping-pong targets of the denoiser passes, the luminance variance is stored in alpha
+		Image* denoiseImages[2] = { nullptr };
+
+		// ReSTIR reservoirs of the primary hits, the current frame's and the history, see shaders/common/restir.glsl
+		Buffer* reservoirBuffers[2] = { nullptr };
+
+		// Tonemapped image in the format of the render settings
+		Image* outputImage = nullptr;
+
+		Shader* tonemapShader = nullptr;
+
+		ComputePipeline* tonemapPipeline = nullptr;
+
+		Shader* temporalShader = nullptr;
+
+		ComputePipeline* temporalPipeline = nullptr;
+
+		Shader* varianceShader = nullptr;
+
+		ComputePipeline* variancePipeline = nullptr;
+
+		Shader* atrousShader = nullptr;
+
+		ComputePipeline* atrousPipeline = nullptr;
+
+		Shader* restirTemporalShader = nullptr;
+
+		ComputePipeline* restirTemporalPipeline = nullptr;
+
+		WavefrontScheduler* wavefront = nullptr;
+
+		// Records the frame graph and owns the memory shared by the transient render targets
+		GraphExecutor* graphExecutor = nullptr;
+
+		GpuTimer* traceTimer = nullptr;
+
+		DynamicResolution* dynamicResolution = nullptr;
+
+		// Off traces every frame from scratch, Progressive averages all frames since the camera or the scene
+		// changed and Temporal reprojects the history of moving scenes. Cycled with A
+		enum class AccumulationMode {
+			Off,
+			Progressive,
+			Temporal
+		};
+
+		AccumulationMode accumulationMode = AccumulationMode::Temporal;
+
+		// Frames in the history, 0 discards it
+		uint32_t accumulatedFrames = 0;
+
+		// Upper bound of the history length in temporal mode, lower values react faster to changes
+		uint32_t maxHistory = 16;
+
+		uint32_t accumulationRevision = 0;
+
+		glm::mat4 accumulationViewInverse = glm::mat4(0.0f);
+
+		glm::mat4 accumulationProjInverse = glm::mat4(0.0f);
+
+		// Direct light of primary hits is either sampled from the light tree at every hit or resampled
+		// with ReSTIR. Toggled with L
+		enum class LightSampling {
+			Tree,
+			Restir
+		};
+
+		LightSampling lightSampling = LightSampling::Restir;
+
+		// Bounces of the path tracer, which replaces the recursive reflections when toggled with P
+		uint32_t pathTracingBounces = 4;
+
+		// Paths are traced by the loop in primary.rgen, or by the kernels of the wavefront path tracer
+		// which sort the hits by material. Toggled with W, the trace timer allows comparing both
+		enum class Scheduler {
+			Megakernel,
+			Wavefront
+		};
+
+		Scheduler scheduler = Scheduler::Megakernel;
+
+		// Toggled with D
+		bool denoiserEnabled = true;
+
+		AtrousFilter::Settings denoiseSettings;
+
+		// Camera of the current frame, and the view projection of the previous frame for motion vectors
+		glm::mat4 viewInverse = glm::mat4(1.0f);
+
+		glm::mat4 projInverse = glm::mat4(1.0f);
+
+		glm::mat4 viewProj = glm::mat4(0.0f);
+
+		glm::mat4 prevViewProj = glm::mat4(0.0f);
+
+		uint32_t frameCount = 0;
+
+		float exposure = 1.0f;
+
+		float whitePoint = 1.0f;
 
-		Buffer* settingsUniformBuffer = nullptr;
+		// Animation can be paused with space, so the accumulation converges
+		bool paused = false;
 
-		Buffer* lightUniformBuffer = nullptr;
+		float animationTime = 0.0f;
 
 		std::vector<VkDescriptorSetLayoutBinding> bindings;
 };
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "atrous_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define ATROUS_SSE
+#endif
+
+// Constants and weights have to match shaders/variance.comp and shaders/atrous.comp
+
+static const float KERNEL[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+static const float EPSILON = 1e-4f;
+
+static float luminance(const float* c) {
+	return c[0] * 0.2126f + c[1] * 0.7152f + c[2] * 0.0722f;
+}
+
+// Accumulates weighted RGBA colors
+struct ColorSum {
+#ifdef ATROUS_SSE
+	__m128 sum = _mm_setzero_ps();
+
+	void add(const float* c, float w) {
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c), _mm_set1_ps(w)));
+	}
+
+	void store(float* c, float scale) const {
+		_mm_storeu_ps(c, _mm_mul_ps(sum, _mm_set1_ps(scale)));
+	}
+#else
+	float sum[4] = {};
+
+	void add(const float* c, float w) {
+		for (int i = 0; i < 4; i++) {
+			sum[i] += c[i] * w;
+		}
+	}
+
+	void store(float* c, float scale) const {
+		for (int i = 0; i < 4; i++) {
+			c[i] = sum[i] * scale;
+		}
+	}
+#endif
+};
+
+AtrousFilter::AtrousFilter(const Settings& settings, uint32_t threadCount)
+	: settings(settings), threadCount(threadCount) {
+
+	if (this->threadCount == 0) {
+		this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+std::vector<float> AtrousFilter::apply(uint32_t width, uint32_t height,
+	const std::vector<float>& color, const std::vector<float>& normalDepth) const {
+
+	size_t size = (size_t) width * height * 4;
+	if (color.size() != size || normalDepth.size() != size) {
+		throw std::logic_error("Image sizes do not match the extent");
+	}
+
+	if (size == 0) {
+		return {};
+	}
+
+	// Ping-pong between two images like the GPU passes
+	std::vector<float> images[2] = { std::vector<float>(size), std::vector<float>(size) };
+
+	estimateVariance(width, height, color.data(), normalDepth.data(), images[0].data());
+
+	for (uint32_t i = 0; i < settings.iterations; i++) {
+		iterate(width, height, 1 << i, images[i % 2].data(), normalDepth.data(), images[(i + 1) % 2].data());
+	}
+
+	return std::move(images[settings.iterations % 2]);
+}
+
+void AtrousFilter::estimateVariance(uint32_t width, uint32_t height, const float* color, const float* normalDepth,
+	float* result) const {
+
+	forEachRow(height, [&](int y) {
+		for (int x = 0; x < (int) width; x++) {
+			size_t p = ((size_t) y * width + x) * 4;
+
+			float variance = 0.0f;
+
+			if (normalDepth[p + 3] > 0.0f) {
+				float m1 = 0.0f;
+				float m2 = 0.0f;
+
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dx = -1; dx <= 1; dx++) {
+						int qx = std::clamp(x + dx, 0, (int) width - 1);
+						int qy = std::clamp(y + dy, 0, (int) height - 1);
+
+						float l = luminance(color + ((size_t) qy * width + qx) * 4);
+						m1 += l;
+						m2 += l * l;
+					}
+				}
+
+				m1 /= 9.0f;
+				m2 /= 9.0f;
+				variance = std::max(m2 - m1 * m1, 0.0f);
+			}
+
+			result[p + 0] = color[p + 0];
+			result[p + 1] = color[p + 1];
+			result[p + 2] = color[p + 2];
+			result[p + 3] = variance;
+		}
+	});
+}
+
+void AtrousFilter::iterate(uint32_t width, uint32_t height, int step, const float* source, const float* normalDepth,
+	float* target) const {
+
+	forEachRow(height, [&](int y) {
+		for (int x = 0; x < (int) width; x++) {
+			size_t p = ((size_t) y * width + x) * 4;
+
+			const float* center = source + p;
+			const float* np = normalDepth + p;
+			float zp = np[3];
+
+			// Nothing to filter where the primary ray missed
+			if (zp <= 0.0f) {
+				std::copy(center, center + 4, target + p);
+				continue;
+			}
+
+			float lp = luminance(center);
+			float luminanceScale = settings.sigmaLuminance * std::sqrt(std::max(center[3], 0.0f)) + EPSILON;
+
+			float w = KERNEL[2] * KERNEL[2];
+			float sumWeight = w;
+			float sumVariance = w * w * center[3];
+
+			ColorSum sum;
+			sum.add(center, w);
+
+			for (int dy = -2; dy <= 2; dy++) {
+				for (int dx = -2; dx <= 2; dx++) {
+					int qx = x + dx * step;
+					int qy = y + dy * step;
+
+					if ((dx == 0 && dy == 0) || qx < 0 || qy < 0 || qx >= (int) width || qy >= (int) height) {
+						continue;
+					}
+
+					size_t q = ((size_t) qy * width + qx) * 4;
+					const float* c = source + q;
+					const float* nq = normalDepth + q;
+
+					if (nq[3] <= 0.0f) {
+						continue;
+					}
+
+					float distance = step * std::sqrt((float) (dx * dx + dy * dy));
+
+					float wl = std::exp(-std::abs(lp - luminance(c)) / luminanceScale);
+					float wn = std::pow(std::max(np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2], 0.0f), settings.sigmaNormal);
+					float wz = std::exp(-std::abs(zp - nq[3]) / (settings.sigmaDepth * zp * distance + EPSILON));
+
+					w = KERNEL[dx + 2] * KERNEL[dy + 2] * wl * wn * wz;
+
+					sum.add(c, w);
+					sumWeight += w;
+					sumVariance += w * w * c[3];
+				}
+			}
+
+			// Alpha of the sum is the weighted variance, which is replaced by the squared weights below
+			sum.store(target + p, 1.0f / sumWeight);
+			target[p + 3] = sumVariance / (sumWeight * sumWeight);
+		}
+	});
+}
+
+template<typename F>
+void AtrousFilter::forEachRow(uint32_t height, F f) const {
+	uint32_t count = std::min(threadCount, height);
+	uint32_t rows = (height + count - 1) / count;
+
+	std::vector<std::thread> threads;
+
+	for (uint32_t t = 0; t < count; t++) {
+		threads.emplace_back([=]() {
+			for (uint32_t y = t * rows; y < std::min(height, (t + 1) * rows); y++) {
+				f((int) y);
+			}
+		});
+	}
+
+	for (auto& t : threads) {
+		t.join();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// CPU reference of the edge-aware a-trous wavelet denoiser in shaders/variance.comp and shaders/atrous.comp,
+// so the filter can be compared against the GPU on machines without one. Rows are filtered on multiple
+// threads, the channels of a pixel with SSE
+class AtrousFilter {
+
+	public:
+
+		// Shared with the GPU passes, see Application::buildFrameGraph()
+		struct Settings {
+			// Every iteration doubles the distance between the filter taps, 5 iterations cover 125 pixels
+			uint32_t iterations = 5;
+
+			// Luminance differences are scaled by the local standard deviation
+			float sigmaLuminance = 4.0f;
+
+			// Exponent of the cosine between normals
+			float sigmaNormal = 128.0f;
+
+			// Tolerated depth difference per pixel of distance, relative to the depth
+			float sigmaDepth = 0.01f;
+		};
+
+		AtrousFilter() : AtrousFilter(Settings()) {}
+
+		// Uses all hardware threads if threadCount is 0
+		AtrousFilter(const Settings& settings, uint32_t threadCount = 0);
+
+		// Images are width * height RGBA floats. color is the noisy radiance, normalDepth the world space
+		// normal and hit distance, which is 0 where the primary ray missed. Returns the filtered radiance
+		// with its variance in alpha, like the GPU passes
+		std::vector<float> apply(uint32_t width, uint32_t height,
+			const std::vector<float>& color, const std::vector<float>& normalDepth) const;
+
+	private:
+
+		void estimateVariance(uint32_t width, uint32_t height, const float* color, const float* normalDepth,
+			float* result) const;
+
+		void iterate(uint32_t width, uint32_t height, int step, const float* source, const float* normalDepth,
+			float* target) const;
+
+		// Calls f(y) for all rows, split into one range per thread
+		template<typename F>
+		void forEachRow(uint32_t height, F f) const;
+
+		Settings settings;
+
+		uint32_t threadCount;
+};
\ No newline at end of file
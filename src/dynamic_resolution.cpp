@@ -0,0 +1,45 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Frames to measure after a change before changing again, timings lag behind by the frames in flight
+static const uint32_t SETTLE_FRAMES = 8;
+
+// Relative change of the scale below which the current resolution is kept
+static const float HYSTERESIS = 0.05f;
+
+static const float SMOOTHING = 0.1f;
+
+DynamicResolution::DynamicResolution(float minScale, float maxScale, float targetTime)
+	: minScale(minScale), maxScale(maxScale), targetTime(targetTime), scale(maxScale) {
+
+}
+
+bool DynamicResolution::update(float time) {
+	if (time <= 0.0f) {
+		return false;
+	}
+
+	averageTime = averageTime < 0.0f ? time : averageTime + (time - averageTime) * SMOOTHING;
+
+	if (++framesSinceChange < SETTLE_FRAMES) {
+		return false;
+	}
+
+	float target = std::clamp(scale * std::sqrt(targetTime / averageTime), minScale, maxScale);
+
+	// Small changes are ignored, unless they reach one of the bounds
+	bool bound = target == minScale || target == maxScale;
+
+	if (target == scale || (!bound && std::abs(target - scale) < scale * HYSTERESIS)) {
+		return false;
+	}
+
+	// Predict the time at the new scale until new measurements come in
+	averageTime *= (target * target) / (scale * scale);
+	scale = target;
+	framesSinceChange = 0;
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Picks the render scale that keeps the measured GPU time close to a target. The pixel count, and
+// therefore roughly the time, grows with the square of the scale
+class DynamicResolution {
+
+	public:
+
+		DynamicResolution(float minScale, float maxScale, float targetTime);
+
+		// Feeds the time of one frame in milliseconds, returns true if the scale changed
+		bool update(float time);
+
+		float getScale() const {
+			return scale;
+		}
+
+	private:
+
+		float minScale, maxScale;
+
+		float targetTime;
+
+		float scale;
+
+		// Exponential moving average of the frame times at the current scale
+		float averageTime = -1.0f;
+
+		uint32_t framesSinceChange = 0;
+};
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "file_watcher.h"
+
+#include <set>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <map>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+// Time the directory has to be quiet before changes are reported
+const int QUIET_PERIOD_MS = 100;
+
+FileWatcher::FileWatcher(const std::string& directory, Callback callback)
+	: directory(directory), callback(callback) {
+
+	if (!std::filesystem::is_directory(directory)) {
+		throw std::runtime_error(std::string("Cannot watch '") + directory + "', not a directory");
+	}
+
+	thread = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher() {
+	running = false;
+	thread.join();
+}
+
+#ifdef _WIN32
+
+void FileWatcher::run() {
+	HANDLE handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+	if (handle == INVALID_HANDLE_VALUE) {
+		std::cout << "Failed to watch '" << directory << "'" << std::endl;
+		return;
+	}
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+	alignas(DWORD) uint8_t buffer[16 * 1024];
+	std::set<std::string> changed;
+	bool pending = false;
+
+	while (running) {
+		if (!pending) {
+			ResetEvent(overlapped.hEvent);
+			pending = ReadDirectoryChangesW(handle, buffer, sizeof(buffer), TRUE,
+				FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &overlapped, nullptr);
+
+			if (!pending) {
+				std::cout << "Failed to read changes of '" << directory << "'" << std::endl;
+				break;
+			}
+		}
+
+		if (WaitForSingleObject(overlapped.hEvent, QUIET_PERIOD_MS) == WAIT_OBJECT_0) {
+			DWORD size = 0;
+			pending = false;
+
+			if (!GetOverlappedResult(handle, &overlapped, &size, FALSE) || size == 0) {
+				continue;
+			}
+
+			auto* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(buffer);
+
+			while (true) {
+				std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+				changed.insert((std::filesystem::path(directory) / name).string());
+
+				if (info->NextEntryOffset == 0) {
+					break;
+				}
+
+				info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(reinterpret_cast<uint8_t*>(info) + info->NextEntryOffset);
+			}
+		} else if (!changed.empty()) {
+			callback({ changed.begin(), changed.end() });
+			changed.clear();
+		}
+	}
+
+	CancelIo(handle);
+	CloseHandle(overlapped.hEvent);
+	CloseHandle(handle);
+}
+
+#else
+
+void FileWatcher::run() {
+	int fd = inotify_init1(IN_NONBLOCK);
+
+	if (fd < 0) {
+		std::cout << "Failed to watch '" << directory << "'" << std::endl;
+		return;
+	}
+
+	// inotify is not recursive, every directory of the tree needs its own watch
+	std::map<int, std::string> watches;
+	auto addWatch = [&](const std::string& path) {
+		int wd = inotify_add_watch(fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+
+		if (wd >= 0) {
+			watches[wd] = path;
+		}
+	};
+
+	addWatch(directory);
+
+	for (const auto& e : std::filesystem::recursive_directory_iterator(directory)) {
+		if (e.is_directory()) {
+			addWatch(e.path().string());
+		}
+	}
+
+	alignas(inotify_event) char buffer[16 * 1024];
+	std::set<std::string> changed;
+
+	while (running) {
+		pollfd pfd = { fd, POLLIN, 0 };
+
+		if (poll(&pfd, 1, QUIET_PERIOD_MS) > 0 && (pfd.revents & POLLIN)) {
+			ssize_t size = read(fd, buffer, sizeof(buffer));
+
+			for (ssize_t offset = 0; offset < size; ) {
+				auto* event = reinterpret_cast<inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+
+				if (event->len == 0) {
+					continue;
+				}
+
+				auto path = (std::filesystem::path(watches[event->wd]) / event->name).string();
+
+				if (event->mask & IN_ISDIR) {
+					if (event->mask & IN_CREATE) {
+						addWatch(path);
+					}
+				} else {
+					changed.insert(path);
+				}
+			}
+		} else if (!changed.empty()) {
+			callback({ changed.begin(), changed.end() });
+			changed.clear();
+		}
+	}
+
+	close(fd);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// Watches a directory tree for modified files on a background thread. Changes are collected
+// until the directory has been quiet for a moment and then reported in one callback, which is
+// invoked on the watcher thread
+class FileWatcher {
+
+	public:
+		typedef std::function<void(const std::vector<std::string>& files)> Callback;
+
+		FileWatcher(const std::string& directory, Callback callback);
+
+		~FileWatcher();
+
+	private:
+		void run();
+
+		std::string directory;
+
+		Callback callback;
+
+		std::atomic<bool> running = true;
+
+		std::thread thread;
+};
\ No newline at end of file
@@ -1,9 +1,52 @@
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 #include "application.h"
 
-int main() {
+// Command line: [--frames-in-flight 1-4] [--present-mode fifo|fifo_relaxed|mailbox|immediate]
+// [--dedicated-queues on|off]
+static Application::RenderSettings parseArguments(int argc, char** argv) {
+	Application::RenderSettings settings;
+
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			throw std::runtime_error(std::string("Missing value of ") + argv[i]);
+		}
+
+		const char* value = argv[++i];
+
+		if (strcmp(argv[i - 1], "--frames-in-flight") == 0) {
+			settings.device.framesInFlight = atoi(value);
+		} else if (strcmp(argv[i - 1], "--present-mode") == 0) {
+			const VkPresentModeKHR modes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+				VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+
+			auto mode = std::find_if(std::begin(modes), std::end(modes), [value](VkPresentModeKHR m) {
+				return strcmp(SwapChain::getPresentModeName(m), value) == 0;
+			});
+
+			if (mode == std::end(modes)) {
+				throw std::runtime_error(std::string("Unknown present mode ") + value);
+			}
+
+			settings.device.presentMode = *mode;
+		} else if (strcmp(argv[i - 1], "--dedicated-queues") == 0) {
+			if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0) {
+				throw std::runtime_error(std::string("Dedicated queues are either on or off, not ") + value);
+			}
+
+			settings.device.dedicatedQueues = strcmp(value, "on") == 0;
+		} else {
+			throw std::runtime_error(std::string("Unknown argument ") + argv[i - 1]);
+		}
+	}
+
+	return settings;
+}
+
+int main(int argc, char** argv) {
 	try {
-		Application app("Vulkan Raytracer", 1600, 900);
+		Application app("Vulkan Raytracer", 1600, 900, parseArguments(argc, argv));
 		app.run();
 	} catch (const std::exception& e) {
 		std::cout << e.what() << std::endl;
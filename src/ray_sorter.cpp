@@ -0,0 +1,65 @@
+#include "ray_sorter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+RaySorter::RaySorter(uint32_t keyCount) : counts(keyCount, 0), offsets(keyCount + 1, 0) {
+	if (keyCount == 0) {
+		throw std::logic_error("Ray sorter needs at least one key");
+	}
+}
+
+std::vector<uint32_t> RaySorter::sort(const std::vector<uint32_t>& keys) {
+	histogram(keys);
+	scan();
+
+	return scatter(keys);
+}
+
+uint32_t RaySorter::getBegin(uint32_t key) const {
+
+	// Offsets end with the total, which belongs to no key
+	if (key >= counts.size()) {
+		throw std::out_of_range("Ray sort key out of range");
+	}
+
+	return offsets[key];
+}
+
+uint32_t RaySorter::getEnd(uint32_t key) const {
+	return getBegin(key) + counts[key];
+}
+
+void RaySorter::histogram(const std::vector<uint32_t>& keys) {
+	std::fill(counts.begin(), counts.end(), 0);
+
+	for (auto key : keys) {
+		if (key >= counts.size()) {
+			throw std::out_of_range("Ray sort key out of range");
+		}
+
+		counts[key]++;
+	}
+}
+
+void RaySorter::scan() {
+	uint32_t offset = 0;
+
+	for (size_t key = 0; key < counts.size(); key++) {
+		offsets[key] = offset;
+		offset += counts[key];
+	}
+
+	offsets.back() = offset;
+}
+
+std::vector<uint32_t> RaySorter::scatter(const std::vector<uint32_t>& keys) const {
+	std::vector<uint32_t> order(keys.size());
+	auto next = offsets;
+
+	for (uint32_t ray = 0; ray < (uint32_t) keys.size(); ray++) {
+		order[next[keys[ray]]++] = ray;
+	}
+
+	return order;
+}
\ No newline at end of file
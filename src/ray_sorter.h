@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// CPU reference of the ray sorting of the wavefront path tracer in shaders/wavefront_sort.comp. Rays are
+// grouped by key with a counting sort in the passes of the GPU: a histogram of the keys, an exclusive
+// prefix sum giving the first slot of every key and a scatter of the ray indices to their slots
+class RaySorter {
+
+	public:
+
+		explicit RaySorter(uint32_t keyCount);
+
+		// Returns the indices of the rays ordered by key. Unlike the GPU scatter, which appends with atomics,
+		// rays with the same key keep their order
+		std::vector<uint32_t> sort(const std::vector<uint32_t>& keys);
+
+		// Slots of a key in the last sorted order are [getBegin(key), getEnd(key))
+		uint32_t getBegin(uint32_t key) const;
+
+		uint32_t getEnd(uint32_t key) const;
+
+		uint32_t getKeyCount() const {
+			return (uint32_t) counts.size();
+		}
+
+	private:
+
+		void histogram(const std::vector<uint32_t>& keys);
+
+		void scan();
+
+		std::vector<uint32_t> scatter(const std::vector<uint32_t>& keys) const;
+
+		// Rays per key
+		std::vector<uint32_t> counts;
+
+		// First slot of every key, followed by the total
+		std::vector<uint32_t> offsets;
+};
\ No newline at end of file
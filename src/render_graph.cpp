@@ -0,0 +1,379 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+uint32_t RenderGraph::addResource(const std::string& name, bool transient, uint64_t size, uint64_t alignment) {
+	if (alignment == 0) {
+		throw std::logic_error("Alignment of render graph resource " + name + " is 0");
+	}
+
+	Resource resource;
+	resource.name = name;
+	resource.transient = transient;
+	resource.size = size;
+	resource.alignment = alignment;
+
+	resources.push_back(resource);
+	compiled = false;
+
+	return (uint32_t) resources.size() - 1;
+}
+
+void RenderGraph::placeResource(uint32_t resource, uint64_t offset) {
+	auto& r = resources.at(resource);
+
+	if (!r.transient) {
+		throw std::logic_error("Render graph resource " + r.name + " is not transient and cannot be placed");
+	}
+
+	if (offset % r.alignment != 0) {
+		throw std::logic_error("Offset of render graph resource " + r.name + " is not aligned");
+	}
+
+	r.placed = true;
+	r.offset = offset;
+	compiled = false;
+}
+
+void RenderGraph::setOutput(uint32_t resource) {
+	resources.at(resource).output = true;
+	compiled = false;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, const Callback& callback) {
+	Pass pass;
+	pass.name = name;
+	pass.callback = callback;
+
+	passes.push_back(pass);
+	compiled = false;
+
+	return (uint32_t) passes.size() - 1;
+}
+
+void RenderGraph::read(uint32_t pass, uint32_t resource, const Usage& usage) {
+	addUse(pass, resource, usage);
+}
+
+void RenderGraph::write(uint32_t pass, uint32_t resource, const Usage& usage) {
+	auto written = usage;
+	written.write = true;
+
+	addUse(pass, resource, written);
+}
+
+void RenderGraph::addUse(uint32_t pass, uint32_t resource, const Usage& usage) {
+	auto& p = passes.at(pass);
+	auto& r = resources.at(resource);
+
+	// A pass reading and writing the same resource declares both, they become a single use
+	for (auto& use : p.uses) {
+		if (use.resource != resource) {
+			continue;
+		}
+
+		if (use.usage.layout != usage.layout) {
+			throw std::logic_error("Pass " + p.name + " uses " + r.name + " in two layouts");
+		}
+
+		use.usage.stages |= usage.stages;
+		use.usage.access |= usage.access;
+		use.usage.write = use.usage.write || usage.write;
+		use.read = use.read || !usage.write;
+		return;
+	}
+
+	Use use;
+	use.resource = resource;
+	use.usage = usage;
+	use.read = !usage.write;
+
+	p.uses.push_back(use);
+	compiled = false;
+}
+
+void RenderGraph::compile() {
+	cull();
+	computeLifetimes();
+	placeTransients();
+	computeDependencies();
+
+	compiled = true;
+}
+
+void RenderGraph::execute(const std::function<void(uint32_t pass)>& prepare) {
+	requireCompiled();
+
+	for (auto pass : order) {
+		if (prepare) {
+			prepare(pass);
+		}
+
+		if (passes[pass].callback) {
+			passes[pass].callback();
+		}
+	}
+}
+
+void RenderGraph::cull() {
+	std::vector<bool> needed(resources.size());
+
+	for (size_t i = 0; i < resources.size(); i++) {
+		needed[i] = resources[i].output;
+	}
+
+	for (size_t i = passes.size(); i-- > 0;) {
+		auto& pass = passes[i];
+		pass.culled = true;
+
+		for (auto& use : pass.uses) {
+			if (use.usage.write && needed[use.resource]) {
+				pass.culled = false;
+			}
+		}
+
+		if (pass.culled) {
+			continue;
+		}
+
+		// Writes without reading replace the contents, earlier writes are only needed if this pass reads them
+		for (auto& use : pass.uses) {
+			if (use.usage.write && !use.read) {
+				needed[use.resource] = false;
+			}
+		}
+
+		for (auto& use : pass.uses) {
+			if (use.read) {
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	order.clear();
+
+	for (uint32_t i = 0; i < (uint32_t) passes.size(); i++) {
+		if (!passes[i].culled) {
+			order.push_back(i);
+		}
+	}
+}
+
+void RenderGraph::computeLifetimes() {
+	for (auto& resource : resources) {
+		resource.firstPass = UNUSED;
+		resource.lastPass = UNUSED;
+	}
+
+	for (auto pass : order) {
+		for (auto& use : passes[pass].uses) {
+			auto& resource = resources[use.resource];
+
+			if (resource.firstPass == UNUSED) {
+				resource.firstPass = pass;
+			}
+
+			resource.lastPass = pass;
+		}
+	}
+}
+
+void RenderGraph::placeTransients() {
+	std::vector<uint32_t> placed, pending;
+
+	for (uint32_t i = 0; i < (uint32_t) resources.size(); i++) {
+		auto& resource = resources[i];
+
+		if (!resource.transient || resource.firstPass == UNUSED) {
+			continue;
+		}
+
+		(resource.placed ? placed : pending).push_back(i);
+	}
+
+	for (size_t i = 0; i < placed.size(); i++) {
+		for (size_t j = i + 1; j < placed.size(); j++) {
+			auto& a = resources[placed[i]];
+			auto& b = resources[placed[j]];
+
+			if (overlapsInTime(a, b) && overlapsInMemory(a, b)) {
+				throw std::logic_error("Render graph resources " + a.name + " and " + b.name +
+					" share memory while both are alive");
+			}
+		}
+	}
+
+	std::stable_sort(pending.begin(), pending.end(), [this](uint32_t a, uint32_t b) {
+		return resources[a].size > resources[b].size;
+	});
+
+	for (auto i : pending) {
+		auto& resource = resources[i];
+
+		// Memory ranges of the resources alive at the same time, by offset
+		std::vector<std::pair<uint64_t, uint64_t>> ranges;
+
+		for (auto j : placed) {
+			auto& other = resources[j];
+
+			if (overlapsInTime(resource, other)) {
+				ranges.push_back({ other.offset, other.offset + other.size });
+			}
+		}
+
+		std::sort(ranges.begin(), ranges.end());
+
+		uint64_t offset = 0;
+
+		for (auto& range : ranges) {
+			if (range.second <= offset) {
+				continue;
+			}
+
+			if (range.first >= offset + resource.size) {
+				break;
+			}
+
+			offset = (range.second + resource.alignment - 1) / resource.alignment * resource.alignment;
+		}
+
+		resource.offset = offset;
+		placed.push_back(i);
+	}
+
+	transientSize = 0;
+
+	for (auto i : placed) {
+		transientSize = std::max(transientSize, resources[i].offset + resources[i].size);
+	}
+}
+
+void RenderGraph::computeDependencies() {
+
+	// Last write and the reads since then, per resource
+	struct State {
+		bool used = false;
+
+		uint32_t writePass = UNUSED;
+
+		Usage writeUsage;
+
+		std::vector<std::pair<uint32_t, Usage>> reads;
+
+		uint32_t layout = 0;
+	};
+
+	std::vector<State> states(resources.size());
+
+	for (auto pass : order) {
+		auto& dependencies = passes[pass].dependencies;
+		dependencies.clear();
+
+		for (auto& use : passes[pass].uses) {
+			auto& state = states[use.resource];
+			auto& resource = resources[use.resource];
+			bool write = use.usage.write || use.usage.layout != state.layout;
+
+			if (!state.used) {
+				// The first use of a transient resource waits until the resources before it in its memory are done
+				for (uint32_t i = 0; resource.transient && i < (uint32_t) resources.size(); i++) {
+					auto& other = resources[i];
+
+					if (i == use.resource || !other.transient || other.lastPass == UNUSED ||
+						other.lastPass >= pass || !overlapsInMemory(resource, other)) {
+						continue;
+					}
+
+					for (auto& otherUse : passes[other.lastPass].uses) {
+						if (otherUse.resource == i) {
+							dependencies.push_back({ use.resource, other.lastPass, otherUse.usage, use.usage, true });
+						}
+					}
+				}
+			} else if (write && !state.reads.empty()) {
+				for (auto& read : state.reads) {
+					dependencies.push_back({ use.resource, read.first, read.second, use.usage, false });
+				}
+			} else if (state.writePass != UNUSED) {
+				dependencies.push_back({ use.resource, state.writePass, state.writeUsage, use.usage, false });
+			}
+
+			if (write) {
+				state.writePass = pass;
+				state.writeUsage = use.usage;
+				state.reads.clear();
+			} else {
+				state.reads.push_back({ pass, use.usage });
+			}
+
+			state.used = true;
+			state.layout = use.usage.layout;
+		}
+	}
+}
+
+const std::vector<uint32_t>& RenderGraph::getOrder() const {
+	requireCompiled();
+	return order;
+}
+
+bool RenderGraph::isCulled(uint32_t pass) const {
+	requireCompiled();
+	return passes.at(pass).culled;
+}
+
+const std::vector<RenderGraph::Use>& RenderGraph::getUses(uint32_t pass) const {
+	return passes.at(pass).uses;
+}
+
+const std::vector<RenderGraph::Dependency>& RenderGraph::getDependencies(uint32_t pass) const {
+	requireCompiled();
+	return passes.at(pass).dependencies;
+}
+
+uint32_t RenderGraph::getFirstPass(uint32_t resource) const {
+	requireCompiled();
+	return resources.at(resource).firstPass;
+}
+
+uint32_t RenderGraph::getLastPass(uint32_t resource) const {
+	requireCompiled();
+	return resources.at(resource).lastPass;
+}
+
+bool RenderGraph::isTransient(uint32_t resource) const {
+	return resources.at(resource).transient;
+}
+
+uint64_t RenderGraph::getOffset(uint32_t resource) const {
+	requireCompiled();
+	return resources.at(resource).offset;
+}
+
+uint64_t RenderGraph::getTransientSize() const {
+	requireCompiled();
+	return transientSize;
+}
+
+const std::string& RenderGraph::getPassName(uint32_t pass) const {
+	return passes.at(pass).name;
+}
+
+const std::string& RenderGraph::getResourceName(uint32_t resource) const {
+	return resources.at(resource).name;
+}
+
+void RenderGraph::requireCompiled() const {
+	if (!compiled) {
+		throw std::logic_error("Render graph has changed since it was compiled");
+	}
+}
+
+bool RenderGraph::overlapsInTime(const Resource& a, const Resource& b) {
+	return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+}
+
+bool RenderGraph::overlapsInMemory(const Resource& a, const Resource& b) {
+	return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Frame composed of passes which declare the resources they read and write. Compiling the graph culls the
+// passes that contribute to none of the outputs, derives the dependencies the remaining passes need
+// barriers for and places the transient resources in shared memory, overlapping wherever their lifetimes
+// do not. The compiler knows nothing about Vulkan, usages are opaque to it apart from writes and layouts,
+// see GraphExecutor for recording a compiled graph
+class RenderGraph {
+
+	public:
+
+		static const uint32_t UNUSED = ~0u;
+
+		// Pipeline stages, access flags and image layout of a use, as interpreted by the executor. A change
+		// of the layout counts as a write
+		struct Usage {
+			uint32_t stages = 0;
+
+			uint32_t access = 0;
+
+			uint32_t layout = 0;
+
+			bool write = false;
+		};
+
+		struct Use {
+			uint32_t resource;
+
+			Usage usage;
+
+			// Whether the pass reads the resource, usages only tell writes
+			bool read;
+		};
+
+		// Earlier use a pass has to wait for. Aliasing dependencies wait for the last pass using another
+		// resource in the same memory, the contents of the resource are undefined at that point
+		struct Dependency {
+			uint32_t resource;
+
+			uint32_t srcPass;
+
+			Usage srcUsage;
+
+			Usage dstUsage;
+
+			bool aliasing;
+		};
+
+		typedef std::function<void()> Callback;
+
+		// Transient resources only live during the frame and may share memory with each other, the others
+		// are imported and keep their contents. Size and alignment are only needed for transient ones
+		uint32_t addResource(const std::string& name, bool transient = false, uint64_t size = 0, uint64_t alignment = 1);
+
+		// Fixes the memory offset of a transient resource, e.g. to the one of the compiled graph its memory
+		// was bound for. Compiling fails if placed resources overlap while they are alive
+		void placeResource(uint32_t resource, uint64_t offset);
+
+		// Marks a resource as read after the frame, such as the back buffer or a history
+		void setOutput(uint32_t resource);
+
+		// Passes run in the order they are added, which has to be a valid order of their uses
+		uint32_t addPass(const std::string& name, const Callback& callback = nullptr);
+
+		void read(uint32_t pass, uint32_t resource, const Usage& usage);
+
+		void write(uint32_t pass, uint32_t resource, const Usage& usage);
+
+		void compile();
+
+		// Runs the callbacks of the remaining passes in order. Prepare is called before every pass, e.g. to
+		// record its barriers
+		void execute(const std::function<void(uint32_t pass)>& prepare = nullptr);
+
+		// Passes remaining after culling, in execution order
+		const std::vector<uint32_t>& getOrder() const;
+
+		bool isCulled(uint32_t pass) const;
+
+		const std::vector<Use>& getUses(uint32_t pass) const;
+
+		const std::vector<Dependency>& getDependencies(uint32_t pass) const;
+
+		// First and last remaining pass using the resource, UNUSED if there is none
+		uint32_t getFirstPass(uint32_t resource) const;
+
+		uint32_t getLastPass(uint32_t resource) const;
+
+		bool isTransient(uint32_t resource) const;
+
+		// Offset of a transient resource in the memory shared by all of them
+		uint64_t getOffset(uint32_t resource) const;
+
+		// Size of the memory shared by the transient resources
+		uint64_t getTransientSize() const;
+
+		const std::string& getPassName(uint32_t pass) const;
+
+		const std::string& getResourceName(uint32_t resource) const;
+
+		uint32_t getPassCount() const {
+			return (uint32_t) passes.size();
+		}
+
+		uint32_t getResourceCount() const {
+			return (uint32_t) resources.size();
+		}
+
+	private:
+
+		struct Pass {
+			std::string name;
+
+			Callback callback;
+
+			std::vector<Use> uses;
+
+			std::vector<Dependency> dependencies;
+
+			bool culled = false;
+		};
+
+		struct Resource {
+			std::string name;
+
+			bool transient = false;
+
+			uint64_t size = 0;
+
+			uint64_t alignment = 1;
+
+			bool placed = false;
+
+			uint64_t offset = 0;
+
+			bool output = false;
+
+			uint32_t firstPass = UNUSED;
+
+			uint32_t lastPass = UNUSED;
+		};
+
+		void addUse(uint32_t pass, uint32_t resource, const Usage& usage);
+
+		// Walks the passes backwards, keeping those writing a resource a later pass or the frame still reads
+		void cull();
+
+		void computeLifetimes();
+
+		// First fit of the transient resources, largest first, next to those alive at the same time
+		void placeTransients();
+
+		void computeDependencies();
+
+		void requireCompiled() const;
+
+		static bool overlapsInTime(const Resource& a, const Resource& b);
+
+		static bool overlapsInMemory(const Resource& a, const Resource& b);
+
+		std::vector<Pass> passes;
+
+		std::vector<Resource> resources;
+
+		std::vector<uint32_t> order;
+
+		uint64_t transientSize = 0;
+
+		bool compiled = false;
+};
\ No newline at end of file
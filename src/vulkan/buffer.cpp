@@ -31,6 +31,7 @@ Buffer::Buffer(Device* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMe
 
 
 Buffer::~Buffer() {
+	device->getTracker().forget(buffer);
 	vkDestroyBuffer(*device, buffer, nullptr);
 	vkFreeMemory(*device, memory, nullptr);
 }
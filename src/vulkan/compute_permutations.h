@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Preprocessor macros of the compute shader permutations. The application loads them with these defines and
+// shaderbake bakes every permutation listed here, so both always agree on the archive keys
+
+// shaders/tonemap.comp keeps HDR values when writing a float image
+inline std::vector<std::string> getTonemapDefines(bool hdr) {
+	if (hdr) {
+		return { "OUTPUT_HDR" };
+	}
+
+	return {};
+}
+
+// Kernels of shaders/wavefront_shade.comp, one per surface kind, indexed by WavefrontScheduler::ShadeKernel
+static const uint32_t SHADE_KERNEL_COUNT = 3;
+
+inline std::vector<std::string> getShadeKernelDefines(uint32_t kernel) {
+	static const char* defines[SHADE_KERNEL_COUNT] = { "SHADE_EMISSION", "SHADE_DIFFUSE", "SHADE_REFLECTIVE" };
+	return { defines[kernel] };
+}
+
+// All permutations of a compute shader by its file name, a single one without defines for the others
+inline std::vector<std::vector<std::string>> getComputePermutations(const std::string& fileName) {
+	if (fileName == "tonemap.comp") {
+		return { getTonemapDefines(false), getTonemapDefines(true) };
+	}
+
+	if (fileName == "wavefront_shade.comp") {
+		std::vector<std::vector<std::string>> permutations;
+
+		for (uint32_t kernel = 0; kernel < SHADE_KERNEL_COUNT; kernel++) {
+			permutations.push_back(getShadeKernelDefines(kernel));
+		}
+
+		return permutations;
+	}
+
+	return { {} };
+}
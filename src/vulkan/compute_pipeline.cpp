@@ -0,0 +1,56 @@
+#include "compute_pipeline.h"
+#include "device.h"
+
+ComputePipeline::ComputePipeline(Device* device, Shader* shader, uint32_t pushConstantSize)
+	: Pipeline(device, getPushConstantRanges(pushConstantSize)), pushConstantSize(pushConstantSize) {
+
+	VkComputePipelineCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	info.stage = shader->getStageInfo();
+	info.layout = layout;
+	info.basePipelineHandle = VK_NULL_HANDLE;
+	info.basePipelineIndex = -1;
+
+	if (vkCreateComputePipelines(*device, device->getPipelineCache(), 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+}
+
+std::vector<VkPushConstantRange> ComputePipeline::getPushConstantRanges(uint32_t size) {
+	if (size == 0) {
+		return {};
+	}
+
+	VkPushConstantRange range = {};
+	range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	range.offset = 0;
+	range.size = size;
+
+	return { range };
+}
+
+void ComputePipeline::prepare(const void* pushConstants) {
+	device->getTracker().validateFlushed("vkCmdDispatch");
+	bind(VK_PIPELINE_BIND_POINT_COMPUTE);
+
+	vkCmdBindDescriptorSets(device->getCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE,
+		layout, 0, 1, &device->getDescriptorSet(), 0, nullptr);
+
+	if (pushConstants) {
+		vkCmdPushConstants(device->getCommandBuffer(), layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize, pushConstants);
+	}
+}
+
+void ComputePipeline::dispatch(VkExtent2D extent, const void* pushConstants) {
+	prepare(pushConstants);
+
+	vkCmdDispatch(device->getCommandBuffer(),
+		(extent.width + GROUP_SIZE - 1) / GROUP_SIZE,
+		(extent.height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+}
+
+void ComputePipeline::dispatchIndirect(VkBuffer buffer, VkDeviceSize offset, const void* pushConstants) {
+	prepare(pushConstants);
+
+	vkCmdDispatchIndirect(device->getCommandBuffer(), buffer, offset);
+}
\ No newline at end of file
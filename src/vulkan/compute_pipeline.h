@@ -0,0 +1,28 @@
+#pragma once
+
+#include "pipeline.h"
+
+// Compute pipeline sharing the descriptor set layout of the device with all other pipelines
+class ComputePipeline : public Pipeline {
+	public:
+		// Work group size in x and y, has to match the local_size of the compute shaders
+		static const uint32_t GROUP_SIZE = 16;
+
+		// Push constants of the given size are passed to every dispatch
+		ComputePipeline(Device* device, Shader* shader, uint32_t pushConstantSize = 0);
+
+		// Binds the pipeline and the descriptor set of the frame, and dispatches one invocation per pixel
+		void dispatch(VkExtent2D extent, const void* pushConstants = nullptr);
+
+		// Dispatches the work groups given by the VkDispatchIndirectCommand at offset in buffer, for sizes
+		// only known on the GPU
+		void dispatchIndirect(VkBuffer buffer, VkDeviceSize offset, const void* pushConstants = nullptr);
+
+	private:
+		// Binds the pipeline, the descriptor set of the frame and the push constants
+		void prepare(const void* pushConstants);
+
+		static std::vector<VkPushConstantRange> getPushConstantRanges(uint32_t size);
+
+		uint32_t pushConstantSize = 0;
+};
\ No newline at end of file
@@ -5,8 +5,12 @@
 #include <set>
 
 Device::Device(Instance* instance, int width, int height, VkSurfaceKHR surface,
-	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo, StringList requiredExtensions)
-	: surface(surface), requiredExtensions(requiredExtensions), descriptorSetLayoutInfo(descriptorSetLayoutInfo) {
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo, StringList requiredExtensions, const Settings& settings)
+	: surface(surface), requiredExtensions(requiredExtensions), settings(settings), descriptorSetLayoutInfo(descriptorSetLayoutInfo) {
+
+	if (settings.framesInFlight < 1 || settings.framesInFlight > MAX_FRAMES) {
+		throw std::logic_error("Frames in flight have to be between 1 and " + std::to_string(MAX_FRAMES));
+	}
 
 	uint32_t count = 0;
 	vkEnumeratePhysicalDevices(*instance, &count, nullptr);
@@ -27,49 +31,93 @@ Device::Device(Instance* instance, int width, int height, VkSurfaceKHR surface,
 Device::~Device() {
 	vkDeviceWaitIdle(device);
 
-	delete swapchain;
-
-	for (auto f : framebuffers) {
-		vkDestroyFramebuffer(device, f, nullptr);
+	for (auto& destroy : deletions) {
+		destroy();
 	}
 
+	// Runs the remaining destructions, which may still free command buffers
+	delete scheduler;
+
+	delete swapchain;
+	destroyFramebuffers();
+
 	vkDestroyRenderPass(device, renderPass, nullptr);
 
-	for (int i = 0; i < MAX_FRAMES; i++) {
+	for (int i = 0; i < settings.framesInFlight; i++) {
 		vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(device, frameFences[i], nullptr);
 	}
 
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-	vkDestroyCommandPool(device, commandPoolSingle, nullptr);
+	for (auto& pool : singleTimePools) {
+		vkDestroyCommandPool(device, pool.pool, nullptr);
+	}
+
+	for (auto& thread : threadPools) {
+		for (int i = 0; i < settings.framesInFlight; i++) {
+			vkDestroyCommandPool(device, thread.second.pools[i], nullptr);
+		}
+	}
+
 	vkDestroyCommandPool(device, commandPool, nullptr);
 	vkDestroyDevice(device, nullptr);
 }
 
 bool Device::frameBegin() {
 
-	vkWaitForFences(device, 1, &frameFences[frameIndex], VK_TRUE, UINT64_MAX);
+	scheduler->wait(frameJobs[frameIndex]);
+	scheduler->collect();
 
-	if (vkAcquireNextImageKHR(device, *swapchain, UINT64_MAX,
+	// The secondary command buffers the threads recorded for the frame have completed
+	{
+		std::lock_guard<std::mutex> lock(threadPoolMutex);
+
+		for (auto& thread : threadPools) {
+			vkResetCommandPool(device, thread.second.pools[frameIndex], 0);
+			thread.second.used[frameIndex] = 0;
+		}
+	}
+
+	// A suboptimal swapchain can still be presented to, framePresent() reports it
+	VkResult result = vkAcquireNextImageKHR(device, *swapchain, UINT64_MAX,
 						      imageAvailableSemaphores[frameIndex], VK_NULL_HANDLE,
-							  &backBufferIndices[frameIndex]) != VK_SUCCESS) {
+							  &backBufferIndices[frameIndex]);
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		return false;
 	}
 
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+		throw std::runtime_error("vkAcquireNextImageKHR failed");
+	}
+
 	VkCommandBufferBeginInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	vkBeginCommandBuffer(commandBuffers[frameIndex], &info);
+	renderPassBegun = false;
+
+	// Resources uploaded or built on the other queues since the last frame
+	recordAcquires(commandBuffers[frameIndex], QueueType::Graphics);
 
 	return true;
 }
 
+VkRenderPass Device::getRenderPass() {
+	if (renderPass == VK_NULL_HANDLE) {
+		createRenderPass();
+		createFramebuffers();
+	}
+
+	return renderPass;
+}
+
 void Device::beginRenderPass() {
 	VkRenderPassBeginInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	info.renderPass = renderPass;
+	info.renderPass = getRenderPass();
 	info.framebuffer = framebuffers[backBufferIndices[frameIndex]];
 	info.renderArea.extent.width = swapchain->getExtent().width;
 	info.renderArea.extent.height = swapchain->getExtent().height;
@@ -80,6 +128,7 @@ void Device::beginRenderPass() {
 	info.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	info.pClearValues = clearValues.data();
 	vkCmdBeginRenderPass(commandBuffers[frameIndex], &info, VK_SUBPASS_CONTENTS_INLINE);
+	renderPassBegun = true;
 }
 
 void Device::endRenderPass() {
@@ -87,31 +136,124 @@ void Device::endRenderPass() {
 }
 
 void Device::frameEnd() {
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV };
-	VkSubmitInfo info = {};
-	info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	info.waitSemaphoreCount = 1;
-	info.pWaitSemaphores = &imageAvailableSemaphores[frameIndex];
-	info.pWaitDstStageMask = waitStages;
-	info.commandBufferCount = 1;
-	info.pCommandBuffers = &commandBuffers[frameIndex];
-	info.signalSemaphoreCount = 1;
-	info.pSignalSemaphores = &renderFinishedSemaphores[frameIndex];
+	// Work before the first use of the back buffer does not wait for it to be acquired
+	JobScheduler::Submission submission;
+	submission.commandBuffers = { commandBuffers[frameIndex] };
+	submission.waitSemaphores = { imageAvailableSemaphores[frameIndex] };
+	submission.waitStages = { renderPassBegun ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT };
+	submission.signalSemaphores = { renderFinishedSemaphores[frameIndex] };
 
 	if (vkEndCommandBuffer(commandBuffers[frameIndex]) != VK_SUCCESS) {
 		throw std::runtime_error("vkEndCommandBuffer failed");
 	}
 
-	if (vkResetFences(device, 1, &frameFences[frameIndex]) != VK_SUCCESS) {
-		throw std::runtime_error("vkResetFences failed");
+	frameJobs[frameIndex] = submit(QueueType::Graphics, submission);
+
+	// Later frames no longer use what was released until now, once this frame and the work on the other
+	// queues it may depend on completed
+	std::vector<std::function<void()>> frameDeletions;
+
+	{
+		std::lock_guard<std::mutex> lock(deletionMutex);
+		frameDeletions.swap(deletions);
+	}
+
+	if (!frameDeletions.empty()) {
+		std::vector<JobScheduler::Job> jobs;
+
+		for (int i = 0; i < QUEUE_TYPE_COUNT; i++) {
+			jobs.push_back(scheduler->getLastJob(i));
+		}
+
+		scheduler->destroyAfter(jobs, [frameDeletions]() {
+			for (auto& destroy : frameDeletions) {
+				destroy();
+			}
+		});
+	}
+}
+
+VkCommandBuffer Device::beginSecondaryCommands(uint32_t threadIndex) {
+	ThreadPools* thread = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(threadPoolMutex);
+		auto it = threadPools.find(threadIndex);
+
+		if (it == threadPools.end()) {
+			ThreadPools pools;
+
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilies[(int) QueueType::Graphics];
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			for (int i = 0; i < settings.framesInFlight; i++) {
+				if (vkCreateCommandPool(device, &poolInfo, nullptr, &pools.pools[i]) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create command pool");
+				}
+			}
+
+			it = threadPools.insert({ threadIndex, pools }).first;
+		}
+
+		// Elements of a map stay where they are, only this thread uses its pools
+		thread = &it->second;
+	}
+
+	auto& commandBuffers = thread->commandBuffers[frameIndex];
+	auto& used = thread->used[frameIndex];
+
+	if (used == commandBuffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = thread->pools[frameIndex];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate command buffers");
+		}
+
+		commandBuffers.push_back(commandBuffer);
+	}
+
+	auto commandBuffer = commandBuffers[used++];
+
+	// Executed outside of a render pass
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+void Device::endSecondaryCommands(VkCommandBuffer commandBuffer) {
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("vkEndCommandBuffer failed");
 	}
+}
 
-	if (vkQueueSubmit(queue, 1, &info, frameFences[frameIndex]) != VK_SUCCESS) {
-		throw std::runtime_error("vkQueueSubmit failed");
+void Device::executeCommands(const std::vector<VkCommandBuffer>& commandBuffers) {
+	if (!commandBuffers.empty()) {
+		vkCmdExecuteCommands(this->commandBuffers[frameIndex], (uint32_t) commandBuffers.size(), commandBuffers.data());
 	}
 }
 
-void Device::framePresent() {
+void Device::destroyLater(const std::function<void()>& destroy) {
+	std::lock_guard<std::mutex> lock(deletionMutex);
+	deletions.push_back(destroy);
+}
+
+bool Device::framePresent() {
 	VkSwapchainKHR swapchains[] = { *swapchain };
 
 	VkPresentInfoKHR info = {};
@@ -122,11 +264,38 @@ void Device::framePresent() {
 	info.pSwapchains = swapchains;
 	info.pImageIndices = &backBufferIndices[frameIndex];
 
-	if (vkQueuePresentKHR(queue, &info) != VK_SUCCESS) {
+	VkResult result = vkQueuePresentKHR(queues[(int) QueueType::Graphics], &info);
+
+	frameIndex = (frameIndex + 1) % settings.framesInFlight;
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+		return false;
+	}
+
+	if (result != VK_SUCCESS) {
 		throw std::runtime_error("vkQueuePresentKHR failed");
 	}
 
-	frameIndex = (frameIndex + 1) % MAX_FRAMES;
+	return true;
+}
+
+void Device::recreateSwapchain(int width, int height) {
+	vkDeviceWaitIdle(device);
+
+	destroyFramebuffers();
+
+	// Format and present mode were already negotiated, the format stays the same so the render pass remains compatible
+	VkExtent2D extent = { (uint32_t) width, (uint32_t) height };
+	auto oldSwapchain = swapchain;
+
+	swapchain = new SwapChain(this, surface, extent, oldSwapchain->getFormat(), VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+		oldSwapchain->getPresentMode(), settings.framesInFlight, oldSwapchain);
+
+	delete oldSwapchain;
+
+	if (renderPass != VK_NULL_HANDLE) {
+		createFramebuffers();
+	}
 }
 
 StringList Device::getExtensions(VkPhysicalDevice device) const {
@@ -146,15 +315,44 @@ StringList Device::getExtensions(VkPhysicalDevice device) const {
 
 void Device::createLogicalDevice(VkPhysicalDevice physicalDevice, int width, int height) {
 	this->physicalDevice = physicalDevice;
-	queueFamily = getQueueFamily(physicalDevice).value();
 
-	// Queues
-	VkDeviceQueueCreateInfo queueInfo = {};
+	// Async compute families support transfers as well, if there is no transfer only family
+	uint32_t graphicsFamily = getQueueFamily(physicalDevice).value();
+	queueFamilies[(int) QueueType::Graphics] = graphicsFamily;
+	queueFamilies[(int) QueueType::Compute] = graphicsFamily;
+	queueFamilies[(int) QueueType::Transfer] = graphicsFamily;
+
+	if (settings.dedicatedQueues) {
+		uint32_t computeFamily = findQueueFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+		uint32_t transferFamily = findQueueFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+		queueFamilies[(int) QueueType::Compute] = computeFamily;
+		queueFamilies[(int) QueueType::Transfer] = transferFamily != graphicsFamily ? transferFamily : computeFamily;
+	}
+
+	// Properties
+	rayTracingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PROPERTIES_NV;
+
+	VkPhysicalDeviceProperties2 deviceProps2 = {};
+	deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProps2.pNext = &rayTracingProperties;
+
+	vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProps2);
+
+	// Queues, one per family. Queue types sharing a family share its queue
+	std::set<uint32_t> families(std::begin(queueFamilies), std::end(queueFamilies));
+	std::vector<VkDeviceQueueCreateInfo> queueInfos;
 	float priority = 1.0f;
-	queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queueInfo.queueFamilyIndex = queueFamily;
-	queueInfo.queueCount = 1;
-	queueInfo.pQueuePriorities = &priority;
+
+	for (auto family : families) {
+		VkDeviceQueueCreateInfo queueInfo = {};
+		queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo.queueFamilyIndex = family;
+		queueInfo.queueCount = 1;
+		queueInfo.pQueuePriorities = &priority;
+
+		queueInfos.push_back(queueInfo);
+	}
 
 	// Features
 	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
@@ -162,12 +360,19 @@ void Device::createLogicalDevice(VkPhysicalDevice physicalDevice, int width, int
 	indexingFeatures.pNext = nullptr;
 	indexingFeatures.runtimeDescriptorArray = VK_TRUE;
 
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.pNext = &indexingFeatures;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
 
 	// Extensions
 	std::vector<const char*> ext;
 	ext.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	ext.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
 
 	std::transform(requiredExtensions.begin(), requiredExtensions.end(), std::back_inserter(ext), [](auto& e) {
 		return e.c_str();
@@ -176,53 +381,61 @@ void Device::createLogicalDevice(VkPhysicalDevice physicalDevice, int width, int
 	// Create device
 	VkDeviceCreateInfo deviceInfo = {};
 	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceInfo.pQueueCreateInfos = &queueInfo;
-	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pQueueCreateInfos = queueInfos.data();
+	deviceInfo.queueCreateInfoCount = (uint32_t) queueInfos.size();
 	deviceInfo.pEnabledFeatures = &deviceFeatures;
 	deviceInfo.enabledExtensionCount = (uint32_t) ext.size();
 	deviceInfo.ppEnabledExtensionNames = ext.data();
-	deviceInfo.pNext = &indexingFeatures;
+	deviceInfo.pNext = &timelineFeatures;
 
 	if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create Vulkan device");
 	}
 
-	// Get queue
-	vkGetDeviceQueue(device, queueFamily, 0, &queue);
+	// Get queues
+	for (int i = 0; i < QUEUE_TYPE_COUNT; i++) {
+		vkGetDeviceQueue(device, queueFamilies[i], 0, &queues[i]);
+	}
 
 	if (VkExt::initDeviceProcs(this) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to setup Vulkan extension procs");
 	}
 
+	scheduler = new JobScheduler(device, std::vector<VkQueue>(std::begin(queues), std::end(queues)));
+
 	// Pools
 	createCommandPools();
 	createCommandBuffers();
 	createSyncObjects();
 	createDescriptorPool();
 	createDescriptorSets();
+	createPipelineCache();
 
 	// Swapchain
 	VkExtent2D extent = { (uint32_t) width, (uint32_t) height };
-	swapchain = new SwapChain(this, surface, extent, VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, VK_PRESENT_MODE_FIFO_KHR);
-
-	createRenderPass();
-	createFramebuffers();
+	swapchain = new SwapChain(this, surface, extent, VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+		settings.presentMode, settings.framesInFlight);
 }
 
 void Device::createCommandPools() {
 	VkCommandPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.queueFamilyIndex = queueFamily;
+	poolInfo.queueFamilyIndex = queueFamilies[(int) QueueType::Graphics];
 	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create command pool");
 	}
 
-	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	// Single time command buffers are reset one by one for reuse
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPoolSingle) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create command pool");
+	for (int i = 0; i < QUEUE_TYPE_COUNT; i++) {
+		poolInfo.queueFamilyIndex = queueFamilies[i];
+
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &singleTimePools[i].pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create command pool");
+		}
 	}
 }
 
@@ -231,7 +444,7 @@ void Device::createCommandBuffers() {
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.commandPool = commandPool;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = MAX_FRAMES;
+	allocInfo.commandBufferCount = settings.framesInFlight;
 
 	if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to allocate command buffers");
@@ -243,14 +456,9 @@ void Device::createSyncObjects() {
 	VkSemaphoreCreateInfo semaphoreInfo = {};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceInfo = {};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (int i = 0; i < MAX_FRAMES; i++) {
+	for (int i = 0; i < settings.framesInFlight; i++) {
 		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(device, &fenceInfo, nullptr, &frameFences[i]) != VK_SUCCESS) {
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create synchronization objects");
 		}
 	}
@@ -319,6 +527,14 @@ void Device::createFramebuffers() {
 	}
 }
 
+void Device::destroyFramebuffers() {
+	for (auto f : framebuffers) {
+		vkDestroyFramebuffer(device, f, nullptr);
+	}
+
+	framebuffers.clear();
+}
+
 void Device::createDescriptorPool() {
 	// Descriptor pool
 	VkDescriptorPoolSize poolSize[] = {
@@ -354,7 +570,7 @@ void Device::createDescriptorSets() {
 		throw std::runtime_error("Failed to create descriptor set layout");
 	}
 
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES, descriptorSetLayout);
+	std::vector<VkDescriptorSetLayout> layouts(settings.framesInFlight, descriptorSetLayout);
 
 	VkDescriptorSetAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -367,6 +583,15 @@ void Device::createDescriptorSets() {
 	}
 }
 
+void Device::createPipelineCache() {
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache");
+	}
+}
+
 bool Device::checkPhysicalDevice(VkPhysicalDevice device) {
 	VkPhysicalDeviceProperties props;
 	vkGetPhysicalDeviceProperties(device, &props);
@@ -374,16 +599,27 @@ bool Device::checkPhysicalDevice(VkPhysicalDevice device) {
 	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
 	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
 
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.pNext = &indexingFeatures;
+
+	auto ext = getExtensions(device);
+
+	// The features of an extension can only be queried if it is supported
+	if (std::find(ext.begin(), ext.end(), VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == ext.end()) {
+		return false;
+	}
+
 	VkPhysicalDeviceFeatures2 deviceFeatures = {};
 	deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-	deviceFeatures.pNext = &indexingFeatures;
+	deviceFeatures.pNext = &timelineFeatures;
 	vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
 	
-	if (!indexingFeatures.runtimeDescriptorArray || !deviceFeatures.features.samplerAnisotropy) {
+	if (!indexingFeatures.runtimeDescriptorArray || !deviceFeatures.features.samplerAnisotropy ||
+		!timelineFeatures.timelineSemaphore) {
 		return false;
 	}
 
-	auto ext = getExtensions(device);
 	for (auto e : requiredExtensions) {
 		if (std::find(ext.begin(), ext.end(), e) == ext.end()) {
 			return false;
@@ -416,37 +652,143 @@ std::optional<uint32_t> Device::getQueueFamily(VkPhysicalDevice device) const {
 	return {};
 }
 
-VkCommandBuffer Device::beginSingleTimeCommands() {
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = commandPoolSingle;
-	allocInfo.commandBufferCount = 1;
+uint32_t Device::findQueueFamily(VkQueueFlags required, VkQueueFlags excluded) const {
+	uint32_t count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> props(count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, props.data());
+
+	for (uint32_t i = 0; i < count; i++) {
+		if ((props[i].queueFlags & required) == required && (props[i].queueFlags & excluded) == 0) {
+			return i;
+		}
+	}
+
+	return queueFamilies[(int) QueueType::Graphics];
+}
+
+VkCommandBuffer Device::beginSingleTimeCommands(QueueType type) {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+	{
+		std::lock_guard<std::mutex> lock(singleTimeMutex);
+		auto& pool = singleTimePools[(int) type];
+
+		// Submits complete in order, so the oldest ones are checked first
+		auto pending = std::find_if(pool.submitted.begin(), pool.submitted.end(), [this](const auto& s) {
+			return !scheduler->isComplete(s.second);
+		});
+
+		for (auto i = pool.submitted.begin(); i != pending; i++) {
+			pool.available.push_back(i->first);
+		}
+
+		pool.submitted.erase(pool.submitted.begin(), pending);
 
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+		if (!pool.available.empty()) {
+			commandBuffer = pool.available.back();
+			pool.available.pop_back();
+
+			vkResetCommandBuffer(commandBuffer, 0);
+		} else {
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = pool.pool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate command buffers");
+			}
+
+			pool.allocated++;
+		}
+	}
 
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	recordAcquires(commandBuffer, type);
 
 	return commandBuffer;
 }
 
-void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType type) {
+	scheduler->wait(submitSingleTimeCommands(commandBuffer, type));
+}
+
+JobScheduler::Job Device::submitSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType type,
+	const std::vector<JobScheduler::Job>& dependencies) {
+
 	vkEndCommandBuffer(commandBuffer);
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+	JobScheduler::Submission submission;
+	submission.commandBuffers = { commandBuffer };
+	submission.dependencies = dependencies;
+
+	auto job = submit(type, submission);
+
+	// Reused by a later submit once the job completed
+	std::lock_guard<std::mutex> lock(singleTimeMutex);
+	singleTimePools[(int) type].submitted.push_back({ commandBuffer, job });
+	singleTimePools[(int) type].submits++;
+
+	return job;
+}
+
+void Device::getSingleTimeStatistics(size_t& submits, size_t& commandBuffers) {
+	std::lock_guard<std::mutex> lock(singleTimeMutex);
+
+	submits = 0;
+	commandBuffers = 0;
+
+	for (auto& pool : singleTimePools) {
+		submits += pool.submits;
+		commandBuffers += pool.allocated;
+	}
+}
+
+JobScheduler::Job Device::submit(QueueType type, JobScheduler::Submission submission) {
+	std::vector<VkCommandBuffer> commandBuffers = submission.commandBuffers;
+
+	{
+		std::lock_guard<std::mutex> lock(acquireMutex);
+
+		for (auto commandBuffer : commandBuffers) {
+			auto wait = acquireWaits.find(commandBuffer);
+
+			if (wait == acquireWaits.end()) {
+				continue;
+			}
+
+			submission.dependencyStages = submission.dependencies.empty() ?
+				wait->second.stages : submission.dependencyStages | wait->second.stages;
+
+			submission.dependencies.insert(submission.dependencies.end(),
+				wait->second.jobs.begin(), wait->second.jobs.end());
+
+			acquireWaits.erase(wait);
+		}
+	}
+
+	auto job = scheduler->submit((uint32_t) type, submission);
 
-	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue);
+	// The acquires of releases in the command buffers can be recorded from now on
+	std::lock_guard<std::mutex> lock(acquireMutex);
 
-	vkFreeCommandBuffers(device, commandPoolSingle, 1, &commandBuffer);
+	for (auto& family : pendingAcquires) {
+		for (auto& acquire : family.second) {
+			if (std::find(commandBuffers.begin(), commandBuffers.end(), acquire.release) != commandBuffers.end()) {
+				acquire.release = VK_NULL_HANDLE;
+				acquire.job = job;
+			}
+		}
+	}
+
+	return job;
 }
 
 uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -485,6 +827,165 @@ void Device::imageBarrier(VkCommandBuffer commandBuffer, VkImage image,
 	barrier.image = image;
 	barrier.subresourceRange = subresourceRange;
 
-	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	tracker.trackBarrier(image, srcAccessMask, dstAccessMask, oldLayout, newLayout);
+
+	vkCmdPipelineBarrier(commandBuffer, getSrcStages(srcAccessMask), getDstStages(dstAccessMask),
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void Device::bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer,
+	VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask) {
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	tracker.trackBarrier(buffer, srcAccessMask, dstAccessMask);
+
+	vkCmdPipelineBarrier(commandBuffer, getSrcStages(srcAccessMask), getDstStages(dstAccessMask),
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Device::transferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, QueueType src, QueueType dst,
+	VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask) {
+
+	if (getQueueFamily(src) == getQueueFamily(dst)) {
+		bufferBarrier(commandBuffer, buffer, srcAccessMask, dstAccessMask);
+		return;
+	}
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = getQueueFamily(src);
+	barrier.dstQueueFamilyIndex = getQueueFamily(dst);
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, getQueueStages(src, ResourceTracker::getStages(srcAccessMask), true),
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	// The acquire repeats the barrier with the destination access
+	Acquire acquire;
+	acquire.buffer = barrier;
+	acquire.buffer.srcAccessMask = 0;
+	acquire.buffer.dstAccessMask = dstAccessMask;
+	acquire.stages = getQueueStages(dst, ResourceTracker::getStages(dstAccessMask), false);
+	acquire.release = commandBuffer;
+
+	std::lock_guard<std::mutex> lock(acquireMutex);
+	pendingAcquires[getQueueFamily(dst)].push_back(acquire);
+}
+
+void Device::transferOwnership(VkCommandBuffer commandBuffer, VkImage image, QueueType src, QueueType dst,
+	VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout) {
+
+	if (getQueueFamily(src) == getQueueFamily(dst)) {
+		imageBarrier(commandBuffer, image, srcAccessMask, dstAccessMask, oldLayout, newLayout);
+		return;
+	}
+
+	// Both halves perform the same layout transition, it happens once
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = 0;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = getQueueFamily(src);
+	barrier.dstQueueFamilyIndex = getQueueFamily(dst);
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, getQueueStages(src, ResourceTracker::getStages(srcAccessMask), true),
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	Acquire acquire;
+	acquire.image = barrier;
+	acquire.image.srcAccessMask = 0;
+	acquire.image.dstAccessMask = dstAccessMask;
+	acquire.isImage = true;
+	acquire.stages = getQueueStages(dst, ResourceTracker::getStages(dstAccessMask), false);
+	acquire.release = commandBuffer;
+
+	std::lock_guard<std::mutex> lock(acquireMutex);
+	pendingAcquires[getQueueFamily(dst)].push_back(acquire);
+}
+
+void Device::recordAcquires(VkCommandBuffer commandBuffer, QueueType type) {
+	std::lock_guard<std::mutex> lock(acquireMutex);
+	auto& pending = pendingAcquires[getQueueFamily(type)];
+
+	std::vector<VkBufferMemoryBarrier> buffers;
+	std::vector<VkImageMemoryBarrier> images;
+	AcquireWait wait;
+
+	// Releases still being recorded are acquired by a later command buffer
+	auto recorded = std::stable_partition(pending.begin(), pending.end(), [](const Acquire& acquire) {
+		return acquire.release != VK_NULL_HANDLE;
+	});
+
+	for (auto i = recorded; i != pending.end(); i++) {
+		if (i->isImage) {
+			images.push_back(i->image);
+		} else {
+			buffers.push_back(i->buffer);
+		}
+
+		wait.jobs.push_back(i->job);
+		wait.stages |= i->stages;
+	}
+
+	pending.erase(recorded, pending.end());
+
+	if (wait.jobs.empty()) {
+		return;
+	}
+
+	// The submission waits for the releases at the stages of the acquires, which the barrier continues from
+	vkCmdPipelineBarrier(commandBuffer, wait.stages, wait.stages, 0, 0, nullptr,
+		(uint32_t) buffers.size(), buffers.data(), (uint32_t) images.size(), images.data());
+
+	acquireWaits[commandBuffer] = wait;
+}
+
+VkPipelineStageFlags Device::getQueueStages(QueueType type, VkPipelineStageFlags stages, bool src) const {
+	const VkPipelineStageFlags common = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	// A family shared with graphics supports everything
+	if (type != QueueType::Graphics && hasDedicatedQueue(type)) {
+		if (type == QueueType::Compute) {
+			stages &= common | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+				VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV;
+		} else {
+			stages &= common;
+		}
+	}
+
+	if (stages == 0) {
+		return src ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	}
+
+	return stages;
+}
+
+VkPipelineStageFlags Device::getSrcStages(VkAccessFlags accessMask) {
+	auto stages = ResourceTracker::getStages(accessMask);
+	return stages ? stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+}
+
+VkPipelineStageFlags Device::getDstStages(VkAccessFlags accessMask) {
+	auto stages = ResourceTracker::getStages(accessMask);
+	return stages ? stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
 }
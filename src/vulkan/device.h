@@ -2,33 +2,74 @@
 
 #include <vulkan/vulkan.hpp>
 #include <optional>
+#include <mutex>
+#include <map>
+#include <memory>
 
 #include "swap_chain.h"
+#include "job_scheduler.h"
 #include "pipeline.h"
+#include "resource_tracker.h"
 
 class Instance;
 typedef std::vector<std::string> StringList;
 
 class Device {
 
-	private:
-		static const int MAX_FRAMES = 2;
-
 	public:
+		// Upper bound of the frames in flight, the per frame objects are allocated up to it
+		static const int MAX_FRAMES = 4;
+
+		// Queues work can be submitted to. Compute and transfer fall back to the graphics queue if the device
+		// has no dedicated family for them, or dedicated queues are disabled
+		enum class QueueType {
+			Graphics,
+			// Compute without graphics, for acceleration structure builds of new geometry
+			Compute,
+			// Transfer only, for uploads
+			Transfer
+		};
+
+		static const int QUEUE_TYPE_COUNT = 3;
+
+		// Presentation settings, negotiated with what the surface supports when the swapchain is created
+		struct Settings {
+			// Frames recorded while the GPU still works on the previous ones, 1 to MAX_FRAMES. More frames
+			// keep the GPU busy at the cost of latency
+			int framesInFlight = 2;
+
+			// Falls back to FIFO, which every surface supports, if the surface does not support the mode
+			VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+			// Uses the compute only and transfer only queue families of the device, so uploads and builds
+			// overlap with the frames on the graphics queue
+			bool dedicatedQueues = true;
+		};
+
 		Device(Instance* instance, int width, int height, VkSurfaceKHR surface,
-			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo, StringList requiredExtensions);
+			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo, StringList requiredExtensions,
+			const Settings& settings = Settings());
 
 		~Device();
 
+		// Returns false if the swapchain is out of date and has to be recreated before the frame can begin
 		bool frameBegin();
 
+		// Only frames with raster work need the render pass. Frames that only trace rays and run compute
+		// shaders write the back buffer with a transfer, so their submission waits for the back buffer at
+		// the transfer stage and tracing overlaps with the presentation of the previous image
 		void beginRenderPass();
 
 		void endRenderPass();
 
 		void frameEnd();
 
-		void framePresent();
+		// Returns false if the swapchain is out of date or no longer matches the surface, e.g. after a resize
+		bool framePresent();
+
+		// Replaces the swapchain and its framebuffers with ones of the given size. Waits for the device to be idle,
+		// everything else stays alive
+		void recreateSwapchain(int width, int height);
 
 		void setClearColor(const VkClearColorValue& value) { clearColor = value; }
 
@@ -36,9 +77,24 @@ class Device {
 
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
+		// Explicit barriers, for command buffers outside of the frame. Their stages are derived from the access
+		// masks, the passes of a frame declare their resources to the tracker instead
 		void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkAccessFlags srcAccessMask,
 			VkAccessFlags dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout);
 
+		void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkAccessFlags srcAccessMask,
+			VkAccessFlags dstAccessMask);
+
+		// Hands a resource written or read on the src queue over to the dst queue. The release barrier is recorded
+		// into the command buffer of the src queue, the acquire barrier into the next command buffer begun for the
+		// dst queue, which has to be submitted after the release completed. Without separate queue families,
+		// this is a plain barrier
+		void transferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, QueueType src, QueueType dst,
+			VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask);
+
+		void transferOwnership(VkCommandBuffer commandBuffer, VkImage image, QueueType src, QueueType dst,
+			VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout);
+
 		operator VkDevice() { return device; }
 
 		VkPhysicalDevice getPhysical() { return physicalDevice; }
@@ -51,12 +107,17 @@ class Device {
 			return getExtensions(physicalDevice);
 		}
 
-		uint32_t getQueueFamily() const {
-			return queueFamily;
+		uint32_t getQueueFamily(QueueType type = QueueType::Graphics) const {
+			return queueFamilies[(int) type];
+		}
+
+		VkQueue getQueue(QueueType type = QueueType::Graphics) {
+			return queues[(int) type];
 		}
 
-		VkQueue getQueue() {
-			return queue;
+		// Whether the queue type has its own family instead of sharing the graphics queue
+		bool hasDedicatedQueue(QueueType type) const {
+			return queueFamilies[(int) type] != queueFamilies[(int) QueueType::Graphics];
 		}
 
 		VkCommandPool getCommandPool() {
@@ -67,6 +128,29 @@ class Device {
 			return commandBuffers[frameIndex];
 		}
 
+		// Secondary command buffer for the current frame, recorded by the thread with the index, e.g. the worker
+		// of a job system. Every thread has its own pool per frame in flight, which is reset when the frame begins
+		// again, so threads record in parallel without locking. The recording has to end before the frame ends
+		VkCommandBuffer beginSecondaryCommands(uint32_t thread = 0);
+
+		void endSecondaryCommands(VkCommandBuffer commandBuffer);
+
+		// Records the secondary command buffers into the frame's command buffer, in the given order
+		void executeCommands(const std::vector<VkCommandBuffer>& commandBuffers);
+
+		// Index of the frame in flight, selects the command buffer and descriptor set
+		int getFrameIndex() const {
+			return frameIndex;
+		}
+
+		int getFrameCount() const {
+			return settings.framesInFlight;
+		}
+
+		const Settings& getSettings() const {
+			return settings;
+		}
+
 		VkImage getBackBuffer() {
 			return swapchain->getImages()[backBufferIndices[frameIndex]];
 		}
@@ -88,16 +172,64 @@ class Device {
 		}
 
 		std::vector<VkDescriptorSet> getDescriptorSets() {
-			return std::vector<VkDescriptorSet>(descriptorSets, descriptorSets + MAX_FRAMES);
+			return std::vector<VkDescriptorSet>(descriptorSets, descriptorSets + settings.framesInFlight);
 		}
 
-		VkRenderPass getRenderPass() {
-			return renderPass;
+		// Created with its framebuffers when first needed
+		VkRenderPass getRenderPass();
+
+		// Barriers between the passes of the frames
+		ResourceTracker& getTracker() {
+			return tracker;
+		}
+
+		VkPipelineCache getPipelineCache() {
+			return pipelineCache;
+		}
+
+		const VkPhysicalDeviceRayTracingPropertiesNV& getRaytracingProperties() const {
+			return rayTracingProperties;
 		}
 
-		VkCommandBuffer beginSingleTimeCommands();
+		// Command buffer submitted on its own to a queue, it begins with the ownership acquires pending for the queue
+		VkCommandBuffer beginSingleTimeCommands(QueueType type = QueueType::Graphics);
 
-		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+		// Submits the command buffer and waits for it to complete, but not for the rest of the queue
+		void endSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType type = QueueType::Graphics);
+
+		// Submits the command buffer without waiting, it is freed once the returned job completed. Resources
+		// the commands use have to stay alive until then, see JobScheduler::destroyAfter
+		JobScheduler::Job submitSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType type = QueueType::Graphics,
+			const std::vector<JobScheduler::Job>& dependencies = {});
+
+		// Single time submits so far and the command buffers they were recorded into, of all queue types
+		void getSingleTimeStatistics(size_t& submits, size_t& commandBuffers);
+
+		// Submits to the queue of the type. Command buffers that recorded ownership acquires additionally wait
+		// for the jobs with the releases
+		JobScheduler::Job submit(QueueType type, JobScheduler::Submission submission);
+
+		// Timelines of the queues, indexed by queue type
+		JobScheduler& getScheduler() {
+			return *scheduler;
+		}
+
+		// Deletes a buffer, image, acceleration structure, pipeline or any other object once the frames that may
+		// use it completed, without waiting. Objects released before the end of a frame live until that frame
+		// and everything submitted to the other queues before it completed
+		template <typename T>
+		void destroyLater(T* object) {
+			if (object) {
+				destroyLater(std::function<void()>([object]() { delete object; }));
+			}
+		}
+
+		template <typename T>
+		void destroyLater(std::unique_ptr<T> object) {
+			destroyLater(object.release());
+		}
+
+		void destroyLater(const std::function<void()>& destroy);
 
 	private:
 		void createCommandPools();
@@ -110,16 +242,34 @@ class Device {
 
 		void createFramebuffers();
 
+		void destroyFramebuffers();
+
 		void createDescriptorPool();
 
 		void createDescriptorSets();
 
+		void createPipelineCache();
+
 		StringList getExtensions(VkPhysicalDevice device) const;
 
+		// Stages of explicit barriers, the top or bottom of the pipe if there is no access to wait for
+		static VkPipelineStageFlags getSrcStages(VkAccessFlags accessMask);
+
+		static VkPipelineStageFlags getDstStages(VkAccessFlags accessMask);
+
 		bool checkPhysicalDevice(VkPhysicalDevice device);
 
 		std::optional<uint32_t> getQueueFamily(VkPhysicalDevice device) const;
 
+		// Family with the required flags and none of the excluded ones, the graphics family if there is none
+		uint32_t findQueueFamily(VkQueueFlags required, VkQueueFlags excluded) const;
+
+		// Stages of a barrier the queue supports, the top or bottom of the pipe if none remains
+		VkPipelineStageFlags getQueueStages(QueueType type, VkPipelineStageFlags stages, bool src) const;
+
+		// Records the acquire barriers waiting for the family of the queue type whose releases were submitted
+		void recordAcquires(VkCommandBuffer commandBuffer, QueueType type);
+
 		void createLogicalDevice(VkPhysicalDevice device, int width, int height);
 
 		VkDevice device = VK_NULL_HANDLE;
@@ -130,24 +280,101 @@ class Device {
 
 		SwapChain* swapchain = nullptr;
 
-		uint32_t queueFamily;
+		uint32_t queueFamilies[QUEUE_TYPE_COUNT] = {};
 
-		VkQueue queue = VK_NULL_HANDLE;
+		VkQueue queues[QUEUE_TYPE_COUNT] = { VK_NULL_HANDLE };
 
 		StringList requiredExtensions;
 
+		Settings settings;
+
 		VkCommandPool commandPool = VK_NULL_HANDLE;
 
-		VkCommandPool commandPoolSingle = VK_NULL_HANDLE;
+		// Command buffers of the single time submits of a queue type. Submitted ones are reset and reused once
+		// their job completed, instead of being freed
+		struct SingleTimePool {
+			VkCommandPool pool = VK_NULL_HANDLE;
+
+			std::vector<VkCommandBuffer> available;
+
+			std::vector<std::pair<VkCommandBuffer, JobScheduler::Job>> submitted;
+
+			// Command buffers allocated from the pool and submits they were used for
+			size_t allocated = 0;
+
+			size_t submits = 0;
+		};
+
+		SingleTimePool singleTimePools[QUEUE_TYPE_COUNT];
+
+		std::mutex singleTimeMutex;
 
 		VkCommandBuffer commandBuffers[MAX_FRAMES] = { VK_NULL_HANDLE };
 
+		// Command pools of a recording thread, one per frame in flight, with the secondary command buffers
+		// allocated from them. The first used ones are in use by the frame
+		struct ThreadPools {
+			VkCommandPool pools[MAX_FRAMES] = { VK_NULL_HANDLE };
+
+			std::vector<VkCommandBuffer> commandBuffers[MAX_FRAMES];
+
+			size_t used[MAX_FRAMES] = {};
+		};
+
+		// By thread index, created on the first request of a thread. The map only changes under the lock
+		std::map<uint32_t, ThreadPools> threadPools;
+
+		std::mutex threadPoolMutex;
+
 		VkRenderPass renderPass = VK_NULL_HANDLE;
 
 		std::vector<VkFramebuffer> framebuffers;
 
 		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+		ResourceTracker tracker;
+
+		VkPhysicalDeviceRayTracingPropertiesNV rayTracingProperties = {};
+
+		// Second half of an ownership transfer, either of a buffer or of an image
+		struct Acquire {
+			VkBufferMemoryBarrier buffer = {};
+
+			VkImageMemoryBarrier image = {};
+
+			bool isImage = false;
+
+			VkPipelineStageFlags stages = 0;
+
+			// Command buffer with the release until it is submitted, then the job of the submission
+			VkCommandBuffer release = VK_NULL_HANDLE;
+
+			JobScheduler::Job job;
+		};
+
+		// Jobs with the releases a command buffer acquired resources of, and the stages the acquires wait at
+		struct AcquireWait {
+			std::vector<JobScheduler::Job> jobs;
+
+			VkPipelineStageFlags stages = 0;
+		};
+
+		// By destination queue family
+		std::map<uint32_t, std::vector<Acquire>> pendingAcquires;
+
+		std::map<VkCommandBuffer, AcquireWait> acquireWaits;
+
+		std::mutex acquireMutex;
+
+		JobScheduler* scheduler = nullptr;
+
+		// Destructions released since the last frame ended, handed to the scheduler with the frame's job
+		std::vector<std::function<void()>> deletions;
+
+		std::mutex deletionMutex;
+
 		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo = {};
@@ -160,11 +387,16 @@ class Device {
 
 		VkSemaphore renderFinishedSemaphores[MAX_FRAMES] = { VK_NULL_HANDLE };
 
-		VkFence frameFences[MAX_FRAMES] = { VK_NULL_HANDLE };
+		// Submission of each frame in flight, waited for before the frame is recorded again
+		JobScheduler::Job frameJobs[MAX_FRAMES];
 
 		VkClearColorValue clearColor = { 1.0f, 0.0f, 0.0f, 1.0f };
 
 		VkClearDepthStencilValue clearDepthStencil = {};
 
 		int frameIndex = 0;
+
+		// Whether the current frame began the render pass, its first use of the back buffer is then the color
+		// attachment output
+		bool renderPassBegun = false;
 };
\ No newline at end of file
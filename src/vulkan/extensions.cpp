@@ -14,6 +14,8 @@ PFN_vkGetRayTracingShaderGroupHandlesNV VkExt::vkGetRayTracingShaderGroupHandles
 PFN_vkGetAccelerationStructureHandleNV VkExt::vkGetAccelerationStructureHandleNV = nullptr;
 PFN_vkCmdWriteAccelerationStructuresPropertiesNV VkExt::vkCmdWriteAccelerationStructuresPropertiesNV = nullptr;
 PFN_vkCompileDeferredNV VkExt::vkCompileDeferredNV = nullptr;
+PFN_vkGetSemaphoreCounterValueKHR VkExt::vkGetSemaphoreCounterValueKHR = nullptr;
+PFN_vkWaitSemaphoresKHR VkExt::vkWaitSemaphoresKHR = nullptr;
 
 VkResult VkExt::initProcs(Instance* instance) {
 	if (instance->isDebug()) {
@@ -78,5 +80,13 @@ VkResult VkExt::initDeviceProcs(Device* device) {
 		return VK_ERROR_EXTENSION_NOT_PRESENT;
 	}
 
+	if ((vkGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(*device, "vkGetSemaphoreCounterValueKHR")) == nullptr) {
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	}
+
+	if ((vkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(*device, "vkWaitSemaphoresKHR")) == nullptr) {
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	}
+
 	return VK_SUCCESS;
 }
\ No newline at end of file
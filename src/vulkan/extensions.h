@@ -18,6 +18,8 @@ namespace VkExt {
 	extern PFN_vkGetAccelerationStructureHandleNV vkGetAccelerationStructureHandleNV;
 	extern PFN_vkCmdWriteAccelerationStructuresPropertiesNV vkCmdWriteAccelerationStructuresPropertiesNV;
 	extern PFN_vkCompileDeferredNV vkCompileDeferredNV;
+	extern PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR;
+	extern PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR;
 
 	VkResult initProcs(Instance* instance);
 	VkResult initDeviceProcs(Device* device);
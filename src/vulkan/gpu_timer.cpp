@@ -0,0 +1,72 @@
+#include "gpu_timer.h"
+
+GpuTimer::GpuTimer(Device* device)
+	: device(device), written(device->getFrameCount(), false) {
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device->getPhysical(), &properties);
+	period = properties.limits.timestampPeriod;
+
+	uint32_t count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysical(), &count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysical(), &count, families.data());
+
+	uint32_t validBits = families[device->getQueueFamily()].timestampValidBits;
+	validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	// Without valid bits timestamps are not supported and nothing is recorded
+	if (validBits == 0) {
+		return;
+	}
+
+	VkQueryPoolCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	info.queryCount = 2 * device->getFrameCount();
+
+	if (vkCreateQueryPool(*device, &info, nullptr, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create query pool");
+	}
+}
+
+GpuTimer::~GpuTimer() {
+	vkDestroyQueryPool(*device, queryPool, nullptr);
+}
+
+void GpuTimer::begin() {
+	if (queryPool == VK_NULL_HANDLE) {
+		return;
+	}
+
+	uint32_t first = 2 * device->getFrameIndex();
+
+	vkCmdResetQueryPool(device->getCommandBuffer(), queryPool, first, 2);
+	vkCmdWriteTimestamp(device->getCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, first);
+}
+
+void GpuTimer::end() {
+	if (queryPool == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkCmdWriteTimestamp(device->getCommandBuffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * device->getFrameIndex() + 1);
+	written[device->getFrameIndex()] = true;
+}
+
+float GpuTimer::getTime() {
+	if (queryPool == VK_NULL_HANDLE || !written[device->getFrameIndex()]) {
+		return -1.0f;
+	}
+
+	// The frame fence has been waited for, so the results are available without waiting again
+	uint64_t timestamps[2];
+	if (vkGetQueryPoolResults(*device, queryPool, 2 * device->getFrameIndex(), 2, sizeof(timestamps),
+		timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return -1.0f;
+	}
+
+	uint64_t ticks = ((timestamps[1] & validMask) - (timestamps[0] & validMask)) & validMask;
+	return (float) (ticks * period / 1000000.0);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "device.h"
+
+// Measures the GPU time between two points of a frame with timestamp queries. Every frame in flight
+// has its own pair of queries, which are read back once the device reuses the frame after its job completed
+class GpuTimer {
+
+	public:
+
+		GpuTimer(Device* device);
+
+		~GpuTimer();
+
+		// Resets the queries of the current frame and writes the start timestamp
+		void begin();
+
+		// Writes the end timestamp once all previously recorded work completed
+		void end();
+
+		// Time in milliseconds measured the last time the current frame was recorded, negative if
+		// there is no result yet or the queue does not support timestamps
+		float getTime();
+
+	private:
+
+		Device* device = nullptr;
+
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+
+		// Nanoseconds per timestamp tick
+		float period = 0.0f;
+
+		uint64_t validMask = 0;
+
+		std::vector<bool> written;
+};
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "graph_executor.h"
+
+GraphExecutor::GraphExecutor(Device* device) : device(device) {}
+
+GraphExecutor::~GraphExecutor() {
+	vkFreeMemory(*device, transientMemory, nullptr);
+}
+
+void GraphExecutor::setImage(uint32_t resource, Image* image) {
+	auto& binding = getBinding(resource);
+	binding.image = *image;
+	binding.owner = image;
+}
+
+void GraphExecutor::setImage(uint32_t resource, VkImage image) {
+	getBinding(resource).image = image;
+}
+
+void GraphExecutor::setBuffer(uint32_t resource, VkBuffer buffer) {
+	getBinding(resource).buffer = buffer;
+}
+
+GraphExecutor::Binding& GraphExecutor::getBinding(uint32_t resource) {
+	if (resource >= bindings.size()) {
+		bindings.resize(resource + 1);
+	}
+
+	return bindings[resource];
+}
+
+void GraphExecutor::allocate(const RenderGraph& graph) {
+	vkFreeMemory(*device, transientMemory, nullptr);
+	transientMemory = VK_NULL_HANDLE;
+	transientSize = graph.getTransientSize();
+	transientStages = 0;
+	transientAccess = 0;
+
+	offsets.assign(graph.getResourceCount(), 0);
+
+	// The memory type has to suit all images placed in it
+	uint32_t memoryTypeBits = ~0u;
+	std::vector<uint32_t> transients;
+
+	for (uint32_t i = 0; i < graph.getResourceCount(); i++) {
+		if (!graph.isTransient(i) || graph.getFirstPass(i) == RenderGraph::UNUSED) {
+			continue;
+		}
+
+		if (i >= bindings.size() || !bindings[i].owner) {
+			throw std::logic_error("Transient render graph resource " + graph.getResourceName(i) + " is not an image");
+		}
+
+		memoryTypeBits &= bindings[i].owner->getMemoryRequirements().memoryTypeBits;
+		transients.push_back(i);
+	}
+
+	if (transients.empty()) {
+		return;
+	}
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = transientSize;
+	allocInfo.memoryTypeIndex = device->findMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (vkAllocateMemory(*device, &allocInfo, nullptr, &transientMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate transient memory");
+	}
+
+	for (auto i : transients) {
+		offsets[i] = graph.getOffset(i);
+		bindings[i].owner->bind(transientMemory, offsets[i]);
+	}
+}
+
+void GraphExecutor::place(RenderGraph& graph) const {
+	for (uint32_t i = 0; i < graph.getResourceCount() && i < offsets.size(); i++) {
+		if (graph.isTransient(i)) {
+			graph.placeResource(i, offsets[i]);
+		}
+	}
+}
+
+void GraphExecutor::execute(RenderGraph& graph) {
+	auto& tracker = device->getTracker();
+	VkPipelineStageFlags stages = 0;
+	VkAccessFlags access = 0;
+
+	graph.execute([&](uint32_t pass) {
+		for (auto& use : graph.getUses(pass)) {
+			if (use.resource >= bindings.size()) {
+				throw std::logic_error("Render graph resource " + graph.getResourceName(use.resource) + " is not bound");
+			}
+
+			auto& binding = bindings[use.resource];
+			auto& usage = use.usage;
+
+			if (binding.buffer != VK_NULL_HANDLE) {
+				tracker.use(binding.buffer, usage.stages, usage.access);
+				continue;
+			}
+
+			// Transient images start undefined, after the last use of the images before them in their memory
+			bool discard = graph.isTransient(use.resource) && graph.getFirstPass(use.resource) == pass;
+
+			if (discard) {
+				VkPipelineStageFlags srcStages = 0;
+				VkAccessFlags srcAccess = 0;
+				bool aliased = false;
+
+				for (auto& dependency : graph.getDependencies(pass)) {
+					if (dependency.resource == use.resource && dependency.aliasing) {
+						srcStages |= dependency.srcUsage.stages;
+						srcAccess |= dependency.srcUsage.access;
+						aliased = true;
+					}
+				}
+
+				// Without a predecessor in this graph, the memory was last used by the previous one
+				if (!aliased) {
+					srcStages = transientStages;
+					srcAccess = transientAccess;
+				}
+
+				tracker.import(binding.image, srcStages, VK_IMAGE_LAYOUT_UNDEFINED, srcAccess);
+			}
+
+			if (graph.isTransient(use.resource)) {
+				stages |= usage.stages;
+				access |= usage.access;
+			}
+
+			tracker.use(binding.image, usage.stages, usage.access, (VkImageLayout) usage.layout, discard);
+		}
+
+		tracker.flush(device->getCommandBuffer());
+	});
+
+	transientStages = stages;
+	transientAccess = access;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "device.h"
+#include "image.h"
+#include "../render_graph.h"
+
+// Records compiled render graphs into the frame's command buffer. Before every pass, its uses are declared
+// to the resource tracker, which places the barriers. The transient images of the graphs share one
+// allocation, the executor places them in it from a graph containing every pass that may run
+class GraphExecutor {
+
+	public:
+
+		explicit GraphExecutor(Device* device);
+
+		~GraphExecutor();
+
+		// Vulkan objects of the graph's resources, by resource index. Transient images have to be created
+		// without memory
+		void setImage(uint32_t resource, Image* image);
+
+		void setImage(uint32_t resource, VkImage image);
+
+		void setBuffer(uint32_t resource, VkBuffer buffer);
+
+		// Allocates the memory of the transient images and binds them at the offsets of the compiled graph,
+		// replacing the previous allocation. The images have to be recreated before
+		void allocate(const RenderGraph& graph);
+
+		// Places the transient resources of a graph at the offsets they were allocated for, to be called
+		// before it is compiled. Its passes must be a subset of those of the allocated graph
+		void place(RenderGraph& graph) const;
+
+		// Records the remaining passes of the compiled graph
+		void execute(RenderGraph& graph);
+
+		VkDeviceSize getTransientSize() const {
+			return transientSize;
+		}
+
+	private:
+
+		struct Binding {
+			VkImage image = VK_NULL_HANDLE;
+
+			VkBuffer buffer = VK_NULL_HANDLE;
+
+			// Set for images the executor may bind to memory
+			Image* owner = nullptr;
+		};
+
+		Binding& getBinding(uint32_t resource);
+
+		Device* device = nullptr;
+
+		std::vector<Binding> bindings;
+
+		VkDeviceMemory transientMemory = VK_NULL_HANDLE;
+
+		VkDeviceSize transientSize = 0;
+
+		// Offsets the transient resources were bound at, by resource index
+		std::vector<VkDeviceSize> offsets;
+
+		// Stages and writes of the transient images in the last executed graph. The next one reuses their
+		// memory, its first images wait for them
+		VkPipelineStageFlags transientStages = 0;
+
+		VkAccessFlags transientAccess = 0;
+};
\ No newline at end of file
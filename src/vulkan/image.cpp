@@ -0,0 +1,88 @@
+#include "image.h"
+
+Image::Image(Device* device, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageLayout layout,
+	bool allocate)
+	: device(device), extent(extent), format(format) {
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = extent.width;
+	imageInfo.extent.height = extent.height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateImage(*device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create image");
+	}
+
+	vkGetImageMemoryRequirements(*device, image, &memoryRequirements);
+
+	if (!allocate) {
+		return;
+	}
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memoryRequirements.size;
+	allocInfo.memoryTypeIndex = device->findMemoryType(memoryRequirements.memoryTypeBits,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (vkAllocateMemory(*device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate image memory");
+	}
+
+	vkBindImageMemory(*device, image, memory, 0);
+
+	// Initial layout
+	if (layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+		auto commandBuffer = device->beginSingleTimeCommands();
+		device->imageBarrier(commandBuffer, image, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, layout);
+		device->endSingleTimeCommands(commandBuffer);
+	}
+
+	createImageView();
+}
+
+void Image::bind(VkDeviceMemory sharedMemory, VkDeviceSize offset) {
+	if (imageView != VK_NULL_HANDLE) {
+		throw std::logic_error("Image is already bound to memory");
+	}
+
+	if (vkBindImageMemory(*device, image, sharedMemory, offset) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to bind image memory");
+	}
+
+	createImageView();
+}
+
+void Image::createImageView() {
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(*device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create image view");
+	}
+}
+
+Image::~Image() {
+	device->getTracker().forget(image);
+	vkDestroyImageView(*device, imageView, nullptr);
+	vkFreeMemory(*device, memory, nullptr);
+	vkDestroyImage(*device, image, nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "device.h"
+
+// Device local 2D image without initial content, such as the render targets of the ray tracer.
+// The image is transitioned to the given layout when it is created
+class Image {
+
+	public:
+
+		// Without allocate, the image has no memory of its own and cannot be used before bind() placed it
+		// in memory shared with other images. It stays in the undefined layout then
+		Image(Device* device, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage,
+			VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL, bool allocate = true);
+
+		~Image();
+
+		// Binds an image created without memory and creates its view. The memory stays owned by the caller
+		void bind(VkDeviceMemory sharedMemory, VkDeviceSize offset);
+
+		const VkMemoryRequirements& getMemoryRequirements() const {
+			return memoryRequirements;
+		}
+
+		operator VkImage() {
+			return image;
+		}
+
+		VkImageView getImageView() {
+			return imageView;
+		}
+
+		VkFormat getFormat() const {
+			return format;
+		}
+
+		const VkExtent2D& getExtent() const {
+			return extent;
+		}
+
+	private:
+
+		Device* device = nullptr;
+
+		VkExtent2D extent = {};
+
+		VkFormat format = VK_FORMAT_UNDEFINED;
+
+		void createImageView();
+
+		VkImage image = VK_NULL_HANDLE;
+
+		VkMemoryRequirements memoryRequirements = {};
+
+		// Null if the image is bound to memory of someone else
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+
+		VkImageView imageView = VK_NULL_HANDLE;
+};
\ No newline at end of file
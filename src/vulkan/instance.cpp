@@ -75,7 +75,8 @@ Device* Instance::createDevice() {
 	return new Device(this, application->getWidth(), application->getHeight(), 
 		application->getSurface(), 
 		application->getDescriptorSetLayoutInfo(), 
-		application->getRequiredDeviceExtensions());
+		application->getRequiredDeviceExtensions(),
+		application->getDeviceSettings());
 }
 
 bool Instance::registerDebugCallback() {
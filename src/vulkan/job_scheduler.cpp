@@ -0,0 +1,221 @@
+#include "job_scheduler.h"
+#include "extensions.h"
+
+#include <algorithm>
+
+JobScheduler::JobScheduler(VkDevice device, const std::vector<VkQueue>& queues)
+	: device(device), queues(queues), submitted(queues.size(), 0), completed(queues.size(), 0) {
+
+	VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	info.pNext = &typeInfo;
+
+	timelines.resize(queues.size(), VK_NULL_HANDLE);
+
+	for (auto& timeline : timelines) {
+		if (vkCreateSemaphore(device, &info, nullptr, &timeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timeline semaphore");
+		}
+	}
+}
+
+JobScheduler::~JobScheduler() {
+	waitIdle();
+	collect();
+
+	for (auto timeline : timelines) {
+		vkDestroySemaphore(device, timeline, nullptr);
+	}
+}
+
+JobScheduler::Job JobScheduler::submit(uint32_t queue, const Submission& submission) {
+	if (submission.waitSemaphores.size() != submission.waitStages.size()) {
+		throw std::logic_error("Every wait semaphore of a submission needs its stages");
+	}
+
+	std::lock_guard<std::mutex> lock(submitMutex);
+
+	// Binary semaphores come first, their values are ignored
+	std::vector<VkSemaphore> waitSemaphores = submission.waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages = submission.waitStages;
+	std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+
+	// Only the latest job of each queue has to be waited for, and none that is known to be complete. Jobs of
+	// the same queue are waited for as well, submission order alone does not order their execution
+	std::vector<uint64_t> dependencies(queues.size(), 0);
+
+	for (auto& job : submission.dependencies) {
+		if (job.value > completed.at(job.queue)) {
+			dependencies[job.queue] = std::max(dependencies[job.queue], job.value);
+		}
+	}
+
+	for (uint32_t i = 0; i < (uint32_t) queues.size(); i++) {
+		if (dependencies[i] != 0) {
+			waitSemaphores.push_back(timelines[i]);
+			waitStages.push_back(submission.dependencyStages);
+			waitValues.push_back(dependencies[i]);
+		}
+	}
+
+	Job job;
+	job.queue = queue;
+	job.value = submitted.at(queue) + 1;
+
+	std::vector<VkSemaphore> signalSemaphores = submission.signalSemaphores;
+	std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+
+	signalSemaphores.push_back(timelines[queue]);
+	signalValues.push_back(job.value);
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.waitSemaphoreValueCount = (uint32_t) waitValues.size();
+	timelineInfo.pWaitSemaphoreValues = waitValues.data();
+	timelineInfo.signalSemaphoreValueCount = (uint32_t) signalValues.size();
+	timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+	VkSubmitInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	info.pNext = &timelineInfo;
+	info.waitSemaphoreCount = (uint32_t) waitSemaphores.size();
+	info.pWaitSemaphores = waitSemaphores.data();
+	info.pWaitDstStageMask = waitStages.data();
+	info.commandBufferCount = (uint32_t) submission.commandBuffers.size();
+	info.pCommandBuffers = submission.commandBuffers.data();
+	info.signalSemaphoreCount = (uint32_t) signalSemaphores.size();
+	info.pSignalSemaphores = signalSemaphores.data();
+
+	if (vkQueueSubmit(queues[queue], 1, &info, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("vkQueueSubmit failed");
+	}
+
+	submitted[queue] = job.value;
+
+	return job;
+}
+
+bool JobScheduler::isComplete(const Job& job) {
+	std::lock_guard<std::mutex> lock(submitMutex);
+	return poll(job);
+}
+
+bool JobScheduler::poll(const Job& job) {
+	if (job.value <= completed.at(job.queue)) {
+		return true;
+	}
+
+	uint64_t value = 0;
+
+	if (VkExt::vkGetSemaphoreCounterValueKHR(device, timelines[job.queue], &value) != VK_SUCCESS) {
+		throw std::runtime_error("vkGetSemaphoreCounterValueKHR failed");
+	}
+
+	completed[job.queue] = std::max(completed[job.queue], value);
+
+	return job.value <= completed[job.queue];
+}
+
+void JobScheduler::wait(const Job& job) {
+	wait(std::vector<Job>{ job });
+}
+
+void JobScheduler::wait(const std::vector<Job>& jobs) {
+	std::vector<VkSemaphore> semaphores;
+	std::vector<uint64_t> values;
+
+	{
+		std::lock_guard<std::mutex> lock(submitMutex);
+
+		for (auto& job : jobs) {
+			if (job.value > submitted.at(job.queue)) {
+				throw std::logic_error("Waiting for a job that was not submitted");
+			}
+
+			if (job.value > completed[job.queue]) {
+				semaphores.push_back(timelines[job.queue]);
+				values.push_back(job.value);
+			}
+		}
+	}
+
+	if (semaphores.empty()) {
+		return;
+	}
+
+	VkSemaphoreWaitInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	info.semaphoreCount = (uint32_t) semaphores.size();
+	info.pSemaphores = semaphores.data();
+	info.pValues = values.data();
+
+	if (VkExt::vkWaitSemaphoresKHR(device, &info, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("vkWaitSemaphoresKHR failed");
+	}
+
+	std::lock_guard<std::mutex> lock(submitMutex);
+
+	for (auto& job : jobs) {
+		completed[job.queue] = std::max(completed[job.queue], job.value);
+	}
+}
+
+void JobScheduler::waitIdle() {
+	std::vector<Job> jobs;
+
+	for (uint32_t i = 0; i < (uint32_t) queues.size(); i++) {
+		jobs.push_back(getLastJob(i));
+	}
+
+	wait(jobs);
+}
+
+JobScheduler::Job JobScheduler::getLastJob(uint32_t queue) {
+	std::lock_guard<std::mutex> lock(submitMutex);
+
+	Job job;
+	job.queue = queue;
+	job.value = submitted.at(queue);
+
+	return job;
+}
+
+void JobScheduler::destroyAfter(const Job& job, const std::function<void()>& destroy) {
+	destroyAfter(std::vector<Job>{ job }, destroy);
+}
+
+void JobScheduler::destroyAfter(const std::vector<Job>& jobs, const std::function<void()>& destroy) {
+	std::lock_guard<std::mutex> lock(destroyMutex);
+	destructions.push_back({ jobs, destroy });
+}
+
+void JobScheduler::collect() {
+	std::vector<std::function<void()>> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(destroyMutex);
+
+		// Pending destructions stay in front
+		auto done = std::stable_partition(destructions.begin(), destructions.end(), [this](auto& d) {
+			return std::any_of(d.first.begin(), d.first.end(), [this](const Job& job) {
+				return !isComplete(job);
+			});
+		});
+
+		for (auto i = done; i != destructions.end(); i++) {
+			ready.push_back(i->second);
+		}
+
+		destructions.erase(done, destructions.end());
+	}
+
+	// Destructions may release further resources, outside of the lock
+	for (auto& destroy : ready) {
+		destroy();
+	}
+}
\ No newline at end of file
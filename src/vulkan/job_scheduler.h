@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <functional>
+#include <mutex>
+
+// Submits command buffers to a set of queues and tracks their completion with one timeline semaphore per
+// queue. Every submission signals the next value of its queue's timeline, which identifies it as a job
+// that other submissions can wait for on the GPU and the CPU can wait for or poll
+class JobScheduler {
+
+	public:
+
+		// Submission on the timeline of a queue. The default job counts as completed
+		struct Job {
+			uint32_t queue = 0;
+
+			uint64_t value = 0;
+		};
+
+		struct Submission {
+			std::vector<VkCommandBuffer> commandBuffers;
+
+			// Jobs on any of the queues the submission waits for, at the dependency stages
+			std::vector<Job> dependencies;
+
+			VkPipelineStageFlags dependencyStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+			// Binary semaphores, e.g. of the swapchain
+			std::vector<VkSemaphore> waitSemaphores;
+
+			std::vector<VkPipelineStageFlags> waitStages;
+
+			std::vector<VkSemaphore> signalSemaphores;
+		};
+
+		// Queues may repeat, e.g. if queue types share a family, their submissions are serialized
+		JobScheduler(VkDevice device, const std::vector<VkQueue>& queues);
+
+		// Waits for all jobs and runs the pending destructions
+		~JobScheduler();
+
+		Job submit(uint32_t queue, const Submission& submission);
+
+		bool isComplete(const Job& job);
+
+		void wait(const Job& job);
+
+		void wait(const std::vector<Job>& jobs);
+
+		void waitIdle();
+
+		// Last job submitted to the queue
+		Job getLastJob(uint32_t queue);
+
+		// Runs destroy once the jobs completed, in collect() or the destructor
+		void destroyAfter(const Job& job, const std::function<void()>& destroy);
+
+		void destroyAfter(const std::vector<Job>& jobs, const std::function<void()>& destroy);
+
+		// Runs the destructions of the completed jobs
+		void collect();
+
+	private:
+
+		// Queries the completed value of the queue's timeline, if the job is not known to be complete yet
+		bool poll(const Job& job);
+
+		VkDevice device = VK_NULL_HANDLE;
+
+		std::vector<VkQueue> queues;
+
+		std::vector<VkSemaphore> timelines;
+
+		// Values of the last submission and the highest known to be completed, per queue
+		std::vector<uint64_t> submitted;
+
+		std::vector<uint64_t> completed;
+
+		std::vector<std::pair<std::vector<Job>, std::function<void()>>> destructions;
+
+		// Guards the queues and the values, destructions have their own lock so they can submit
+		std::mutex submitMutex;
+
+		std::mutex destroyMutex;
+};
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "light_tree.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+void LightTree::build(const std::vector<glm::vec3>& positions, const std::vector<float>& powers) {
+	if (positions.size() != powers.size()) {
+		throw std::logic_error("Every light needs a position and a power");
+	}
+
+	nodes.clear();
+	nodes.reserve(getNodeCount(positions.size()));
+	nodes.push_back(Node{ glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), -1 });
+
+	if (positions.empty()) {
+		return;
+	}
+
+	this->positions = &positions;
+	this->powers = &powers;
+
+	indices.resize(positions.size());
+	std::iota(indices.begin(), indices.end(), 0);
+
+	buildNode(0, 0, indices.size());
+
+	this->positions = nullptr;
+	this->powers = nullptr;
+}
+
+void LightTree::buildNode(uint32_t node, size_t begin, size_t end) {
+	const auto& p = *positions;
+
+	glm::vec3 boundsMin = p[indices[begin]];
+	glm::vec3 boundsMax = p[indices[begin]];
+	float power = 0.0f;
+
+	for (size_t i = begin; i < end; i++) {
+		boundsMin = glm::min(boundsMin, p[indices[i]]);
+		boundsMax = glm::max(boundsMax, p[indices[i]]);
+		power += (*powers)[indices[i]];
+	}
+
+	if (end - begin == 1) {
+		nodes[node] = Node{ boundsMin, power, boundsMax, -(int32_t) indices[begin] - 1 };
+		return;
+	}
+
+	// Split at the median of the largest axis
+	glm::vec3 extent = boundsMax - boundsMin;
+	int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+	size_t middle = (begin + end) / 2;
+
+	std::nth_element(indices.begin() + begin, indices.begin() + middle, indices.begin() + end,
+		[&](uint32_t a, uint32_t b) { return p[a][axis] < p[b][axis]; });
+
+	uint32_t child = (uint32_t) nodes.size();
+	nodes.resize(nodes.size() + 2);
+	nodes[node] = Node{ boundsMin, power, boundsMax, (int32_t) child };
+
+	buildNode(child, begin, middle);
+	buildNode(child + 1, middle, end);
+}
\ No newline at end of file
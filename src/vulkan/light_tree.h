@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// Bounding volume hierarchy over point lights. Hit shaders descend it stochastically, choosing
+// each child in proportion to its power over the squared distance (sampleLight() in
+// shaders/common/light_tree.glsl), so sampling costs O(log n) instead of O(n) per hit
+class LightTree {
+
+	public:
+
+		// Matches LightNode in shaders/common/types.glsl
+		struct Node {
+			glm::vec3 boundsMin;
+			float power;
+			glm::vec3 boundsMax;
+			// Index of the first of two adjacent children, or -(light index + 1) for leaves
+			int32_t child;
+		};
+
+		// Power is the importance of a light, e.g. the luminance of its intensity. Without lights
+		// the tree consists of a root without power
+		void build(const std::vector<glm::vec3>& positions, const std::vector<float>& powers);
+
+		const std::vector<Node>& getNodes() const {
+			return nodes;
+		}
+
+		// Number of nodes of a tree over the given number of lights
+		static std::size_t getNodeCount(std::size_t lightCount) {
+			return lightCount > 0 ? 2 * lightCount - 1 : 1;
+		}
+
+	private:
+
+		void buildNode(uint32_t node, std::size_t begin, std::size_t end);
+
+		const std::vector<glm::vec3>* positions = nullptr;
+
+		const std::vector<float>* powers = nullptr;
+
+		// Light indices, partitioned while building
+		std::vector<uint32_t> indices;
+
+		std::vector<Node> nodes;
+};
\ No newline at end of file
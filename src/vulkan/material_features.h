@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Material feature bits. Every combination used in a scene selects its own hit shader permutation,
+// so the shaders do not have to branch on the material at runtime
+enum MaterialFeature : uint32_t {
+	MATERIAL_FEATURE_ALBEDO_MAP = 1 << 0,
+	MATERIAL_FEATURE_NORMAL_MAP = 1 << 1,
+	MATERIAL_FEATURE_REFLECTIVE = 1 << 2,
+	// Alpha mask in the third texture, cut out by an any-hit shader on meshes
+	MATERIAL_FEATURE_ALPHA_TEST = 1 << 3,
+	MATERIAL_FEATURE_ALL = (1 << 4) - 1
+};
+
+// Preprocessor macros the hit shaders expect for the given feature mask
+inline std::vector<std::string> getMaterialDefines(uint32_t features) {
+	std::vector<std::string> defines;
+
+	if (features & MATERIAL_FEATURE_ALBEDO_MAP) {
+		defines.push_back("MATERIAL_ALBEDO_MAP");
+	}
+
+	if (features & MATERIAL_FEATURE_NORMAL_MAP) {
+		defines.push_back("MATERIAL_NORMAL_MAP");
+	}
+
+	if (features & MATERIAL_FEATURE_REFLECTIVE) {
+		defines.push_back("MATERIAL_REFLECTIVE");
+	}
+
+	if (features & MATERIAL_FEATURE_ALPHA_TEST) {
+		defines.push_back("MATERIAL_ALPHA_TEST");
+	}
+
+	return defines;
+}
\ No newline at end of file
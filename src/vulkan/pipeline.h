@@ -19,7 +19,7 @@ class Pipeline {
 		VkPipelineLayout getLayout() { return layout; }
 
 	protected:
-		Pipeline(Device* device);
+		Pipeline(Device* device, const std::vector<VkPushConstantRange>& pushConstantRanges = {});
 
 		Device* device = nullptr;
 
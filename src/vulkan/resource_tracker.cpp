@@ -0,0 +1,303 @@
+#include "resource_tracker.h"
+
+#include <iostream>
+#include <stdexcept>
+
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+	VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV;
+
+void ResourceTracker::use(VkImage image, VkPipelineStageFlags stages, VkAccessFlags access,
+	VkImageLayout layout, bool discard) {
+
+	for (auto& pending : pendingImages) {
+		if (pending.first != image) {
+			continue;
+		}
+
+		if (pending.second.layout != layout) {
+			throw std::logic_error("Image used in two layouts by the same pass");
+		}
+
+		merge(pending.second, stages, access);
+		pending.second.discard = pending.second.discard && discard;
+		return;
+	}
+
+	pendingImages.push_back({ image, { stages, access, layout, discard } });
+}
+
+void ResourceTracker::use(VkBuffer buffer, VkPipelineStageFlags stages, VkAccessFlags access) {
+	for (auto& pending : pendingBuffers) {
+		if (pending.first == buffer) {
+			merge(pending.second, stages, access);
+			return;
+		}
+	}
+
+	pendingBuffers.push_back({ buffer, { stages, access, VK_IMAGE_LAYOUT_UNDEFINED, false } });
+}
+
+void ResourceTracker::import(VkImage image, VkPipelineStageFlags stages, VkImageLayout layout, VkAccessFlags access) {
+	State state;
+	state.readStages = stages;
+	state.layout = layout;
+
+	if (access & WRITE_ACCESS) {
+		state.writeStages = stages;
+		state.writeAccess = access & WRITE_ACCESS;
+	}
+
+	images[image] = state;
+}
+
+void ResourceTracker::flush(VkCommandBuffer commandBuffer) {
+	VkPipelineStageFlags srcStages = 0;
+	VkPipelineStageFlags dstStages = 0;
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+
+	for (auto& pending : pendingImages) {
+		const Use& use = pending.second;
+
+		// Images are assumed to be in the declared layout when they are used for the first time
+		auto it = images.find(pending.first);
+		if (it == images.end()) {
+			it = images.insert({ pending.first, State() }).first;
+			it->second.layout = use.discard ? VK_IMAGE_LAYOUT_UNDEFINED : use.layout;
+		}
+
+		State& state = it->second;
+		bool transition = use.discard || use.layout != state.layout;
+		auto dependency = getDependency(state, use, transition);
+
+		if (dependency.required) {
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = dependency.srcAccess;
+			barrier.dstAccessMask = use.access;
+			barrier.oldLayout = use.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+			barrier.newLayout = use.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = pending.first;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.layerCount = 1;
+
+			imageBarriers.push_back(barrier);
+			srcStages |= dependency.srcStages;
+			dstStages |= use.stages;
+		}
+
+		apply(state, use, dependency, transition);
+	}
+
+	for (auto& pending : pendingBuffers) {
+		const Use& use = pending.second;
+		State& state = buffers[pending.first];
+		auto dependency = getDependency(state, use, false);
+
+		if (dependency.required) {
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = dependency.srcAccess;
+			barrier.dstAccessMask = use.access;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = pending.first;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+
+			bufferBarriers.push_back(barrier);
+			srcStages |= dependency.srcStages;
+			dstStages |= use.stages;
+		}
+
+		apply(state, use, dependency, false);
+	}
+
+	pendingImages.clear();
+	pendingBuffers.clear();
+
+	if (imageBarriers.empty() && bufferBarriers.empty()) {
+		return;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		dstStages ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+		(uint32_t) bufferBarriers.size(), bufferBarriers.data(),
+		(uint32_t) imageBarriers.size(), imageBarriers.data());
+}
+
+void ResourceTracker::validateFlushed(const char* command) {
+	if (!validation || (pendingImages.empty() && pendingBuffers.empty())) {
+		return;
+	}
+
+	std::cout << "Missing barrier: " << pendingImages.size() << " images and " << pendingBuffers.size()
+		<< " buffers are used without flush() before " << command << std::endl;
+}
+
+void ResourceTracker::trackBarrier(VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+	VkImageLayout oldLayout, VkImageLayout newLayout) {
+
+	auto it = images.find(image);
+	if (it == images.end()) {
+		return;
+	}
+
+	State& state = it->second;
+	Use use = { getStages(dstAccess), dstAccess, newLayout, oldLayout == VK_IMAGE_LAYOUT_UNDEFINED };
+
+	bool transition = use.discard || newLayout != state.layout;
+	auto dependency = getDependency(state, use, transition);
+
+	if (validation && !use.discard && oldLayout != state.layout) {
+		std::cout << "Missing transition: barrier on image " << std::hex << (uint64_t) image << std::dec
+			<< " expects layout " << oldLayout << ", the image is in layout " << state.layout << std::endl;
+	} else if (validation && !dependency.required) {
+		std::cout << "Redundant barrier on image " << std::hex << (uint64_t) image << std::dec << std::endl;
+	} else if (validation && (state.writeAccess & ~srcAccess)) {
+		std::cout << "Missing barrier: the barrier on image " << std::hex << (uint64_t) image << std::dec
+			<< " does not wait for its last write" << std::endl;
+	}
+
+	apply(state, use, dependency, transition);
+}
+
+void ResourceTracker::trackBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+	auto it = buffers.find(buffer);
+	if (it == buffers.end()) {
+		return;
+	}
+
+	State& state = it->second;
+	Use use = { getStages(dstAccess), dstAccess, VK_IMAGE_LAYOUT_UNDEFINED, false };
+	auto dependency = getDependency(state, use, false);
+
+	if (validation && !dependency.required) {
+		std::cout << "Redundant barrier on buffer " << std::hex << (uint64_t) buffer << std::dec << std::endl;
+	} else if (validation && (state.writeAccess & ~srcAccess)) {
+		std::cout << "Missing barrier: the barrier on buffer " << std::hex << (uint64_t) buffer << std::dec
+			<< " does not wait for its last write" << std::endl;
+	}
+
+	apply(state, use, dependency, false);
+}
+
+void ResourceTracker::forget(VkImage image) {
+	images.erase(image);
+}
+
+void ResourceTracker::forget(VkBuffer buffer) {
+	buffers.erase(buffer);
+}
+
+VkPipelineStageFlags ResourceTracker::getStages(VkAccessFlags access) {
+	VkPipelineStageFlags stages = 0;
+
+	if (access & VK_ACCESS_INDIRECT_COMMAND_READ_BIT) {
+		stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	}
+
+	if (access & (VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT)) {
+		stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	}
+
+	if (access & (VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)) {
+		stages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV;
+	}
+
+	if (access & VK_ACCESS_INPUT_ATTACHMENT_READ_BIT) {
+		stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+
+	if (access & (VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT)) {
+		stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+
+	if (access & (VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)) {
+		stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	}
+
+	if (access & (VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT)) {
+		stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+
+	if (access & (VK_ACCESS_HOST_READ_BIT | VK_ACCESS_HOST_WRITE_BIT)) {
+		stages |= VK_PIPELINE_STAGE_HOST_BIT;
+	}
+
+	if (access & (VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV)) {
+		stages |= VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV;
+	}
+
+	if (access & (VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT)) {
+		stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	}
+
+	return stages;
+}
+
+ResourceTracker::Dependency ResourceTracker::getDependency(const State& state, const Use& use, bool transition) {
+	Dependency dependency;
+	bool write = (use.access & WRITE_ACCESS) != 0;
+
+	// After a write, unless a barrier already made it visible to the same stages and accesses
+	if (state.writeStages && ((use.stages & ~state.visibleStages) || (use.access & ~state.visibleAccess))) {
+		dependency.required = true;
+		dependency.srcStages |= state.writeStages;
+		dependency.srcAccess |= state.writeAccess;
+	}
+
+	// Writes after reads only have to wait for the reading stages, a layout transition is a write too
+	if ((write || transition) && state.readStages) {
+		dependency.required = true;
+		dependency.srcStages |= state.readStages;
+	}
+
+	if (transition) {
+		dependency.required = true;
+		dependency.srcStages |= state.writeStages;
+		dependency.srcAccess |= state.writeAccess;
+	}
+
+	return dependency;
+}
+
+void ResourceTracker::apply(State& state, const Use& use, const Dependency& dependency, bool transition) {
+	bool write = (use.access & WRITE_ACCESS) != 0;
+
+	if (write) {
+		state.writeStages = use.stages;
+		state.writeAccess = use.access & WRITE_ACCESS;
+		state.visibleStages = 0;
+		state.visibleAccess = 0;
+		state.readStages = 0;
+	} else if (transition) {
+		// The transition happened in the barrier, which made it visible to the declared reads
+		state.writeStages = use.stages;
+		state.writeAccess = 0;
+		state.visibleStages = use.stages;
+		state.visibleAccess = use.access;
+		state.readStages = use.stages;
+	} else {
+		if (dependency.required) {
+			state.visibleStages |= use.stages;
+			state.visibleAccess |= use.access;
+		}
+
+		state.readStages |= use.stages;
+	}
+
+	state.layout = use.layout;
+}
+
+void ResourceTracker::merge(Use& use, VkPipelineStageFlags stages, VkAccessFlags access) {
+	use.stages |= stages;
+	use.access |= access;
+}
\ No newline at end of file
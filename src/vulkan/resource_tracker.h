@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+// Tracks the last access of the images and buffers used by the passes of a frame and places the barriers
+// between them. A pass declares everything it reads and writes with use(), flush() then records the
+// barriers all of its resources need as a single vkCmdPipelineBarrier, with the stages of the previous
+// accesses as source instead of ALL_COMMANDS. Reads after a barrier made a write visible to them need no
+// further barrier, and writes after reads only wait for the reading stages. The state carries over
+// between frames, since they are recorded and submitted in order on the same queue
+class ResourceTracker {
+
+	public:
+
+		// Logs declared uses that are not flushed before the next command, and explicit barriers on
+		// tracked resources that are redundant or expect another layout
+		void setValidation(bool enabled) {
+			validation = enabled;
+		}
+
+		bool getValidation() const {
+			return validation;
+		}
+
+		// Declares a use of the image by the next pass. Its contents are dropped if discard is set, by
+		// a transition from the undefined layout
+		void use(VkImage image, VkPipelineStageFlags stages, VkAccessFlags access,
+			VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL, bool discard = false);
+
+		void use(VkBuffer buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+
+		// Sets the state of an image handed over from outside the command buffer, e.g. a back buffer
+		// whose acquire semaphore is waited for at the given stages. Writes of the given accesses by those
+		// stages are made available by the next barrier, e.g. those of another image in the same memory
+		void import(VkImage image, VkPipelineStageFlags stages, VkImageLayout layout, VkAccessFlags access = 0);
+
+		// Records the barriers of the declared uses
+		void flush(VkCommandBuffer commandBuffer);
+
+		// With validation, logs declared uses that were not flushed before the given command
+		void validateFlushed(const char* command);
+
+		// Updates the state of a tracked resource after an explicit barrier. With validation, logs barriers
+		// that are redundant or expect another layout than the tracked one
+		void trackBarrier(VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+			VkImageLayout oldLayout, VkImageLayout newLayout);
+
+		void trackBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+
+		// Drops the state of a destroyed resource, since its handle may be reused
+		void forget(VkImage image);
+
+		void forget(VkBuffer buffer);
+
+		// Shader and pipeline stages that perform the given accesses, 0 if there are none
+		static VkPipelineStageFlags getStages(VkAccessFlags access);
+
+	private:
+
+		struct State {
+			// Stages and accesses of the last write, or of the barrier that performed the last layout transition
+			VkPipelineStageFlags writeStages = 0;
+
+			VkAccessFlags writeAccess = 0;
+
+			// Stages and accesses the last write was made visible to by a barrier
+			VkPipelineStageFlags visibleStages = 0;
+
+			VkAccessFlags visibleAccess = 0;
+
+			// Stages reading since the last write, the next write has to wait for them
+			VkPipelineStageFlags readStages = 0;
+
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		};
+
+		// Use declared for the next flush, merged if a pass declares the same resource twice
+		struct Use {
+			VkPipelineStageFlags stages;
+
+			VkAccessFlags access;
+
+			VkImageLayout layout;
+
+			bool discard;
+		};
+
+		// Source stages and accesses of the barrier a use needs, no barrier if required is false
+		struct Dependency {
+			bool required = false;
+
+			VkPipelineStageFlags srcStages = 0;
+
+			VkAccessFlags srcAccess = 0;
+		};
+
+		static Dependency getDependency(const State& state, const Use& use, bool transition);
+
+		static void apply(State& state, const Use& use, const Dependency& dependency, bool transition);
+
+		static void merge(Use& use, VkPipelineStageFlags stages, VkAccessFlags access);
+
+		bool validation = false;
+
+		std::unordered_map<VkImage, State> images;
+
+		std::unordered_map<VkBuffer, State> buffers;
+
+		std::vector<std::pair<VkImage, Use>> pendingImages;
+
+		std::vector<std::pair<VkBuffer, Use>> pendingBuffers;
+};
\ No newline at end of file
@@ -52,16 +52,45 @@ void AccelerationStructure::allocateMemory() {
 		VK_BUFFER_USAGE_RAY_TRACING_BIT_NV, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 }
 
-void AccelerationStructure::build(const VkAccelerationStructureInfoNV& info, Buffer* instanceBuffer, bool updateOnly) {
+void AccelerationStructure::build(const VkAccelerationStructureInfoNV& info, Buffer* instanceBuffer, bool updateOnly,
+	VkCommandBuffer commandBuffer) {
+
+	auto cmdBuffer = commandBuffer ? commandBuffer : device->beginSingleTimeCommands(queue);
+
+	// Frames submitted before may still trace the structure that is updated
+	if (updateOnly) {
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+	}
 
-	auto cmdBuffer = device->beginSingleTimeCommands();
 	VkExt::vkCmdBuildAccelerationStructureNV(cmdBuffer, &info,
 		instanceBuffer ? *instanceBuffer : VK_NULL_HANDLE, 0, false,
 		accelerationStructure, updateOnly ? accelerationStructure : VK_NULL_HANDLE,
 		*scratchBuffer, 0);
 
 	barrier(cmdBuffer);
-	device->endSingleTimeCommands(cmdBuffer);
+
+	// The hit shaders read the geometry on the graphics queue. The structure itself has no queue family
+	// ownership, the build completed before the graphics queue uses it
+	for (auto buffer : geometryBuffers) {
+		device->transferOwnership(cmdBuffer, buffer, queue, Device::QueueType::Graphics,
+			0, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	geometryBuffers.clear();
+
+	// Recorded builds are submitted with their command buffer
+	if (commandBuffer) {
+		return;
+	}
+
+	// Updates are ordered before the frames tracing them by the barrier, nothing has to wait for them. The
+	// first build completes before anything can reference the structure
+	if (updateOnly) {
+		device->submitSingleTimeCommands(cmdBuffer, queue);
+	} else {
+		device->endSingleTimeCommands(cmdBuffer, queue);
+	}
 }
 
 void AccelerationStructure::computeMemoryRequirements(const VkAccelerationStructureInfoNV& info) {
@@ -87,12 +116,13 @@ void AccelerationStructure::computeMemoryRequirements(const VkAccelerationStruct
 	scratchMemoryRequirements = req.memoryRequirements;
 }
 
+// Builds of the top level structure read the bottom level ones, ray tracing shaders read both
 void AccelerationStructure::barrier(VkCommandBuffer commandBuffer) {
 	VkMemoryBarrier memoryBarrier;
 	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
 	memoryBarrier.pNext = nullptr;
-	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
 
 	vkCmdPipelineBarrier(commandBuffer,
 		VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV,
@@ -23,7 +23,9 @@ class AccelerationStructure {
 
 		void allocateMemory();
 
-		void build(const VkAccelerationStructureInfoNV& info, Buffer* instanceBuffer, bool updateOnly = false);
+		// Submits the build on its own, or records it into the command buffer if there is one
+		void build(const VkAccelerationStructureInfoNV& info, Buffer* instanceBuffer, bool updateOnly = false,
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
 
 		void create(const VkAccelerationStructureInfoNV& info, Buffer* instanceBuffer = nullptr);
 
@@ -31,6 +33,13 @@ class AccelerationStructure {
 
 		Device* device = nullptr;
 
+		// Queue the builds run on. Structures of new geometry can be built on the compute queue, those the
+		// frames in flight trace against have to stay on the graphics queue
+		Device::QueueType queue = Device::QueueType::Graphics;
+
+		// Buffers read by the first build, handed over to the graphics queue afterwards
+		std::vector<VkBuffer> geometryBuffers;
+
 		VkAccelerationStructureNV accelerationStructure = VK_NULL_HANDLE;
 
 		VkAccelerationStructureInfoNV info = {};
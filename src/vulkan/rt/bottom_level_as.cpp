@@ -34,6 +34,10 @@ BottomLevelAS::BottomLevelAS(Device* device,
 	info.geometryCount = 1;
 	info.pGeometries = &geometry;
 
+	// New geometry is built on the compute queue, the buffers were handed to it by their upload
+	queue = Device::QueueType::Compute;
+	geometryBuffers = { *vertexBuffer, *indexBuffer };
+
 	create(info);
 }
 
@@ -73,6 +77,9 @@ BottomLevelAS::BottomLevelAS(Device* device, float radius, bool isOpaque)
 	info.geometryCount = 1;
 	info.pGeometries = &geometry;
 
+	// The host visible AABB buffer needs no ownership transfer
+	queue = Device::QueueType::Compute;
+
 	create(info);
 }
 
@@ -2,11 +2,27 @@
 #include "../extensions.h"
 
 #include <algorithm>
+#include <array>
+#include <tuple>
+
+bool RaytracingPipeline::Settings::operator<(const Settings& other) const {
+	return std::tie(maxBounces, tmin, tmax, samplesPerPixel, pathTracing) <
+		std::tie(other.maxBounces, other.tmin, other.tmax, other.samplesPerPixel, other.pathTracing);
+}
 
 RaytracingPipeline::RaytracingPipeline(Device* device) 
 	: Pipeline(device) {
 }
 
+RaytracingPipeline::~RaytracingPipeline() {
+	for (auto& v : variants) {
+		vkDestroyPipeline(*device, v.second, nullptr);
+	}
+
+	// Already destroyed as one of the variants
+	pipeline = VK_NULL_HANDLE;
+}
+
 uint32_t RaytracingPipeline::startHitGroup() {
 	if (isHitGroupOpen) {
 		throw std::logic_error("Hit group already open");
@@ -83,11 +99,45 @@ uint32_t RaytracingPipeline::addShaderStage(Shader* shader) {
 	return (uint32_t) shaderGroups.size() - 1;
 }
 
-RaytracingPipeline* RaytracingPipeline::create() {
+RaytracingPipeline* RaytracingPipeline::create(const Settings& settings) {
+	this->settings = settings;
+
+	auto it = variants.find(settings);
+	if (it != variants.end()) {
+		pipeline = it->second;
+		return this;
+	}
+
+	// Specialization constants, the IDs match the constant_id layout qualifiers in constants.glsl
+	std::array<VkSpecializationMapEntry, 5> mapEntries = {{
+		{ 0, offsetof(Settings, maxBounces), sizeof(uint32_t) },
+		{ 1, offsetof(Settings, tmin), sizeof(float) },
+		{ 2, offsetof(Settings, tmax), sizeof(float) },
+		{ 3, offsetof(Settings, samplesPerPixel), sizeof(uint32_t) },
+		{ 4, offsetof(Settings, pathTracing), sizeof(VkBool32) }
+	}};
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = (uint32_t) mapEntries.size();
+	specializationInfo.pMapEntries = mapEntries.data();
+	specializationInfo.dataSize = sizeof(Settings);
+	specializationInfo.pData = &settings;
+
+	auto stages = shaderStages;
+	for (auto& s : stages) {
+		s.pSpecializationInfo = &specializationInfo;
+	}
+
+	// Primary rays are traced from the raygen shader, every bounce adds one level and the
+	// closest hit shader of the last bounce still traces a shadow ray. The path tracer traces
+	// all rays from the raygen shader
+	uint32_t maxRecursionDepth = settings.pathTracing ? 1 :
+		std::min(settings.maxBounces + 2, device->getRaytracingProperties().maxRecursionDepth);
+
 	VkRayTracingPipelineCreateInfoNV info = {};
 	info.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
-	info.stageCount = (uint32_t) shaderStages.size();
-	info.pStages = shaderStages.data();
+	info.stageCount = (uint32_t) stages.size();
+	info.pStages = stages.data();
 	info.groupCount = (uint32_t) shaderGroups.size();
 	info.pGroups = shaderGroups.data();
 	info.maxRecursionDepth = maxRecursionDepth;
@@ -95,45 +145,57 @@ RaytracingPipeline* RaytracingPipeline::create() {
 	info.basePipelineHandle = VK_NULL_HANDLE;
 	info.basePipelineIndex = 0;
 
-	if (VkExt::vkCreateRayTracingPipelinesNV(*device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+	if (VkExt::vkCreateRayTracingPipelinesNV(*device, device->getPipelineCache(), 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create raytracing pipeline");
 	}
 
+	variants[settings] = pipeline;
 	return this;
 }
 
-ShaderBindingTable* RaytracingPipeline::generateShaderBindingTable() {
+ShaderBindingTable* RaytracingPipeline::generateShaderBindingTable(const std::vector<HitRecord>& hitRecords,
+	uint32_t hitGroupCopies) {
 
 	ShaderBindingTable* sbt = new ShaderBindingTable(device, this);
 
-	for (auto& g : shaderGroups) {
+	// Group indices of the hit groups, in the order they were started
+	std::vector<uint32_t> hitGroups;
 
-		ShaderBindingTable::EntryType type;
+	for (uint32_t i = 0; i < (uint32_t) shaderGroups.size(); i++) {
+		const auto& g = shaderGroups[i];
 
 		if (g.type == VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_NV) {
 
 			auto stage = shaderStages[g.generalShader].stage;
 
 			if (stage == VK_SHADER_STAGE_RAYGEN_BIT_NV) {
-				type = ShaderBindingTable::EntryType::RayGen;
+				sbt->addEntry(ShaderBindingTable::EntryType::RayGen, i);
 			} else if (stage == VK_SHADER_STAGE_MISS_BIT_NV) {
-				type = ShaderBindingTable::EntryType::Miss;
+				sbt->addEntry(ShaderBindingTable::EntryType::Miss, i);
 			} else if (stage == VK_SHADER_STAGE_CALLABLE_BIT_NV) {
-				type = ShaderBindingTable::EntryType::Callable;
+				sbt->addEntry(ShaderBindingTable::EntryType::Callable, i);
 			} else {
 				throw std::logic_error("Unsupported shader stage added");
 			}
 
 		} else if (g.type == VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_NV) {
-			type = ShaderBindingTable::EntryType::HitGroup;
+			hitGroups.push_back(i);
 		} else if (g.type == VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_NV) {
-			type = ShaderBindingTable::EntryType::HitGroup;
+			hitGroups.push_back(i);
 		} else {
 			throw std::logic_error("Unsupported shader group type added");
 		}
+	}
 
-		sbt->addEntry(type);
+	if (hitRecords.empty()) {
+		for (auto g : hitGroups) {
+			sbt->addEntry(ShaderBindingTable::EntryType::HitGroup, g);
+		}
+	} else {
+		for (const auto& r : hitRecords) {
+			sbt->addEntry(ShaderBindingTable::EntryType::HitGroup, hitGroups.at(r.hitGroup), r.data.data(), r.data.size());
+		}
 	}
 
-	return sbt->create();
+	return sbt->create(hitGroupCopies);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../pipeline.h"
 #include "shader_binding_table.h"
 #include <optional>
+#include <map>
 
 struct ShaderGroup {
 	VkRayTracingShaderGroupCreateInfoNV getInfo() const {
@@ -25,8 +26,24 @@ struct ShaderGroup {
 
 class RaytracingPipeline : public Pipeline {
 	public:
+		// Settings passed to all shader stages as specialization constants. Every distinct set of
+		// settings results in its own pipeline variant
+		struct Settings {
+			uint32_t maxBounces = 1;
+			float tmin = 0.001f;
+			float tmax = 48.0f;
+			uint32_t samplesPerPixel = 1;
+			// Bounces are traced iteratively by the ray generation shader, which limits the recursion
+			// depth to the shadow rays it traces
+			VkBool32 pathTracing = VK_FALSE;
+
+			bool operator<(const Settings& other) const;
+		};
+
 		RaytracingPipeline(Device* device);
 
+		~RaytracingPipeline();
+
 		// Start the description of a hit group, that contains at least a closest hit shader, but may
 		// also contain an intesection shader and a any-hit shader. The method outputs the index of the
 		// created hit group
@@ -41,10 +58,23 @@ class RaytracingPipeline : public Pipeline {
 		// Add a general shader stage, and return the index of the created stage
 		uint32_t addShaderStage(Shader* shader);
 
-		// Finalize the pipeline
-		RaytracingPipeline* create();
+		// Finalize the pipeline and make the variant for the given settings the active one. Variants
+		// are only created once and shared through the device pipeline cache
+		RaytracingPipeline* create(const Settings& settings = Settings());
+
+		const Settings& getSettings() const { return settings; }
 
-		ShaderBindingTable* generateShaderBindingTable();
+		// Record in the hit group section of the shader binding table, referencing a hit group by the
+		// index returned from startHitGroup() and carrying inline data for its shaders
+		struct HitRecord {
+			uint32_t hitGroup;
+			ByteArray data;
+		};
+
+		// Without hit records, every hit group gets one record without inline data. See ShaderBindingTable::create()
+		// for the copies of the hit records
+		ShaderBindingTable* generateShaderBindingTable(const std::vector<HitRecord>& hitRecords = {},
+			uint32_t hitGroupCopies = 1);
 
 	private:
 		// Shader stages contained in the pipeline
@@ -63,7 +93,10 @@ class RaytracingPipeline : public Pipeline {
 
 		uint32_t currentHitGroup = 0;
 
-		uint32_t maxRecursionDepth = 8;
+		// Pipeline variants, the active one is also stored in pipeline
+		std::map<Settings, VkPipeline> variants;
+
+		Settings settings;
 
 };
 
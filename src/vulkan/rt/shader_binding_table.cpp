@@ -9,18 +9,24 @@
 
 ShaderBindingTable::ShaderBindingTable(Device* device, Pipeline* pipeline) 
 	: device(device), pipeline(pipeline) {
-	getRaytracingProperties();
+	shaderGroupHandleSize = device->getRaytracingProperties().shaderGroupHandleSize;
+	shaderGroupBaseAlignment = device->getRaytracingProperties().shaderGroupBaseAlignment;
 }
 
 ShaderBindingTable::~ShaderBindingTable() {
 	delete buffer;
 }
 
-ShaderBindingTable* ShaderBindingTable::create() {
+ShaderBindingTable* ShaderBindingTable::create(uint32_t hitGroupCopies) {
+
+	this->hitGroupCopies = hitGroupCopies;
+	staleCopies.assign(hitGroupCopies, false);
 
 	uint32_t groupCount = 0;
 	for (const auto& e : entries) {
-		groupCount += (uint32_t) e.size();
+		for (const auto& entry : e) {
+			groupCount = std::max(groupCount, entry.group + 1);
+		}
 	}
 
 	ByteArray shaderHandles(groupCount * shaderGroupHandleSize);
@@ -40,7 +46,11 @@ ShaderBindingTable* ShaderBindingTable::create() {
 	// Copy the shader identifiers followed by their resource pointers or root constants: first the
 	// ray generation, then the miss shaders, and finally the set of hit groups
 	for (int i = 0; i < (int) EntryType::Count; i++) {
-		data += copyShaderData((EntryType) i, data, shaderHandles.data());
+		copyShaderData((EntryType) i, data + getOffset((EntryType) i), shaderHandles.data());
+	}
+
+	for (uint32_t copy = 1; copy < hitGroupCopies; copy++) {
+		copyShaderData(EntryType::HitGroup, data + getOffset(EntryType::HitGroup, copy), shaderHandles.data());
 	}
 
 	buffer->unmap();
@@ -48,21 +58,52 @@ ShaderBindingTable* ShaderBindingTable::create() {
 	return this;
 }
 
+void ShaderBindingTable::updateEntry(EntryType type, uint32_t index, const void* data, size_t dataSize) {
+
+	// Other sections are shared by all copies
+	if (type != EntryType::HitGroup) {
+		throw std::logic_error("Only hit records can be updated after the shader binding table was created");
+	}
+
+	auto& entry = entries[(int) type].at(index);
+
+	if (dataSize > entry.inlineData.size()) {
+		throw std::logic_error("Shader binding table entry data exceeds the entry size");
+	}
+
+	memcpy_s(entry.inlineData.data(), entry.inlineData.size(), data, dataSize);
+
+	staleCopies.assign(hitGroupCopies, true);
+}
+
+void ShaderBindingTable::writeHitGroups(uint32_t copy) {
+
+	if (!staleCopies.at(copy)) {
+		return;
+	}
+
+	// The shader identifiers do not change, only the inline data is rewritten
+	auto* mapped = (uint8_t*) buffer->map(getOffset(EntryType::HitGroup, copy), getSectionSize(EntryType::HitGroup));
+	copyShaderData(EntryType::HitGroup, mapped, nullptr, true);
+	buffer->unmap();
+
+	staleCopies[copy] = false;
+}
+
 VkDeviceSize ShaderBindingTable::copyShaderData(EntryType type, uint8_t* outputData,
 	const uint8_t* shaderHandleStorage, bool inlineDataOnly) {
 
 	uint8_t* pData = outputData;
 	const auto& entries = this->entries[(int) type];
-	auto entrySize = getEntrySize(entries);
+	auto entrySize = getEntrySize(type);
 
 	for (int i = 0; i < entries.size(); i++) {
-		uint32_t groupIndex = getBaseIndex(type) + i;
 		const auto& data = entries[i].inlineData;
 
 		// Copy the shader identifier that was previously obtained with
 		// vkGetRayTracingShaderGroupHandlesNV
 		if (!inlineDataOnly) {
-			memcpy(pData, shaderHandleStorage + groupIndex * shaderGroupHandleSize, shaderGroupHandleSize);
+			memcpy(pData, shaderHandleStorage + entries[i].group * shaderGroupHandleSize, shaderGroupHandleSize);
 		}
 
 		// Copy all its resources pointers or values in bulk
@@ -76,19 +117,6 @@ VkDeviceSize ShaderBindingTable::copyShaderData(EntryType type, uint8_t* outputD
 	return static_cast<uint32_t>(entries.size()) * entrySize;
 }
 
-void ShaderBindingTable::getRaytracingProperties() {
-	VkPhysicalDeviceRayTracingPropertiesNV rayTracingProperties = {};
-	rayTracingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PROPERTIES_NV;
-
-	VkPhysicalDeviceProperties2 deviceProps2 = {};
-	deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
-	deviceProps2.pNext = &rayTracingProperties;
-
-	vkGetPhysicalDeviceProperties2(device->getPhysical(), &deviceProps2);
-
-	shaderGroupHandleSize = rayTracingProperties.shaderGroupHandleSize;
-}
-
 VkDeviceSize ShaderBindingTable::getEntrySize(const std::vector<Entry>& entries) const {
 	// Find the maximum number of parameters used by a single entry
 	size_t maxDataSize = 0;
@@ -104,13 +132,7 @@ VkDeviceSize ShaderBindingTable::getEntrySize(const std::vector<Entry>& entries)
 }
 
 VkDeviceSize ShaderBindingTable::getSize() {
-
-	VkDeviceSize entrySizes = 0;
-	for (const auto& e : entries) {
-		entrySizes += getEntrySize(e) * e.size();
-	}
-
-	return entrySizes;
+	return getOffset(EntryType::Count);
 }
 
 uint32_t ShaderBindingTable::getBaseIndex(EntryType type) const {
@@ -125,18 +147,28 @@ uint32_t ShaderBindingTable::getBaseIndex(EntryType type) const {
 }
 
 VkDeviceSize ShaderBindingTable::getSectionSize(EntryType type) const {
-	return getEntrySize(type) * entries[(int) type].size();
+	// Every section starts at a multiple of the base alignment
+	return ROUND_UP(getEntrySize(type) * entries[(int) type].size(), shaderGroupBaseAlignment);
 }
 
 VkDeviceSize ShaderBindingTable::getEntrySize(EntryType type) const {
+	// Each ray generation entry is the start of a launch, so it has to be aligned like a section
+	if (type == EntryType::RayGen) {
+		return ROUND_UP(getEntrySize(entries[(int) type]), shaderGroupBaseAlignment);
+	}
+
 	return getEntrySize(entries[(int) type]);
 }
 
-VkDeviceSize ShaderBindingTable::getOffset(EntryType type) const {
+VkDeviceSize ShaderBindingTable::getOffset(EntryType type, uint32_t copy) const {
 	VkDeviceSize offset = 0;
 
 	for (int i = 0; i < (int) type; i++) {
-		offset += getSectionSize((EntryType) i);
+		offset += getSectionSize((EntryType) i) * ((EntryType) i == EntryType::HitGroup ? hitGroupCopies : 1);
+	}
+
+	if (type == EntryType::HitGroup) {
+		offset += getSectionSize(type) * copy;
 	}
 
 	return offset;
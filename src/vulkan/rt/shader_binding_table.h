@@ -15,14 +15,17 @@ class ShaderBindingTable {
 			Count
 		};
 
-		// Wrapper for SBT entries, each consisting of the (implicit) name of the program and a list of values,
-		// which can be either offsets or raw 32-bit constants
+		// Wrapper for SBT entries, each consisting of the index of the shader group in the pipeline and a
+		// list of values, which can be either offsets or raw 32-bit constants. Several entries may refer
+		// to the same group, e.g. to give every instance its own hit record
 		struct Entry {
-			Entry(const void* data, size_t dataSize) {
+			Entry(uint32_t group, const void* data, size_t dataSize) : group(group) {
 				inlineData.resize(dataSize);
 				memcpy_s(inlineData.data(), inlineData.size(), data, dataSize);
 			}
 
+			uint32_t group;
+
 			ByteArray inlineData;
 		};
 
@@ -30,11 +33,20 @@ class ShaderBindingTable {
 
 		~ShaderBindingTable();
 
-		void addEntry(EntryType type, const void* data = nullptr, size_t dataSize = 0) {
-			entries[(int) type].push_back(Entry(data, dataSize));
+		void addEntry(EntryType type, uint32_t group, const void* data = nullptr, size_t dataSize = 0) {
+			entries[(int) type].push_back(Entry(group, data, dataSize));
 		}
 
-		ShaderBindingTable* create();
+		// The hit group section is stored hitGroupCopies times, e.g. once per frame in flight, so hit records
+		// can change while other frames still trace with theirs
+		ShaderBindingTable* create(uint32_t hitGroupCopies = 1);
+
+		// Overwrites the inline data of a single hit record in the created table. The data may not be
+		// larger than the data the table was created with. The copies only see it after writeHitGroups()
+		void updateEntry(EntryType type, uint32_t index, const void* data, size_t dataSize);
+
+		// Writes the hit records updated since the copy was last written, which no running trace may read
+		void writeHitGroups(uint32_t copy);
 
 		Buffer* getBuffer() { return buffer; }
 
@@ -44,7 +56,8 @@ class ShaderBindingTable {
 
 		VkDeviceSize getEntrySize(EntryType type) const;
 
-		VkDeviceSize getOffset(EntryType type) const;
+		// Offset of the section in the buffer, EntryType::Count returns the size of the table
+		VkDeviceSize getOffset(EntryType type, uint32_t copy = 0) const;
 
 		VkDeviceSize getShaderGroupHandleSize() const {
 			return shaderGroupHandleSize;
@@ -57,8 +70,6 @@ class ShaderBindingTable {
 		VkDeviceSize copyShaderData(EntryType type, uint8_t* outputData,
 			const uint8_t* shaderHandleStorage, bool inlineDataOnly = false);
 
-		void getRaytracingProperties();
-
 		VkDeviceSize getEntrySize(const std::vector<Entry>& entries) const;
 
 		VkDeviceSize getSize();
@@ -69,7 +80,14 @@ class ShaderBindingTable {
 
 		VkDeviceSize shaderGroupHandleSize = 0;
 
+		VkDeviceSize shaderGroupBaseAlignment = 0;
+
 		std::vector<Entry> entries[(int) EntryType::Count];
 
+		uint32_t hitGroupCopies = 1;
+
+		// Copies of the hit group section that miss updated records
+		std::vector<bool> staleCopies;
+
 		Buffer* buffer = nullptr;
 };
\ No newline at end of file
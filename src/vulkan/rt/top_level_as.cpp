@@ -19,9 +19,12 @@ TopLevelAS::TopLevelAS(Device* device, const std::vector<Instance>& instances, b
 TopLevelAS::~TopLevelAS() {
 }
 
-void TopLevelAS::update(const std::vector<Instance>& instances) {
+void TopLevelAS::update(const std::vector<Instance>& instances, VkCommandBuffer commandBuffer) {
 	std::unique_ptr<Buffer> buffer(createInstanceBuffer(instances));
-	build(info, buffer.get(), true);
+	build(info, buffer.get(), true, commandBuffer);
+
+	// The update is still pending
+	device->destroyLater(std::move(buffer));
 }
 
 Buffer* TopLevelAS::createInstanceBuffer(const std::vector<Instance>& instances) {
@@ -38,8 +41,8 @@ Buffer* TopLevelAS::createInstanceBuffer(const std::vector<Instance>& instances)
 		VkGeometryInstance gInst;
 		gInst.instanceId = inst.instanceId;
 		gInst.mask = inst.mask;
-		gInst.instanceOffset = inst.hitGroupIndex;
-		gInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV;
+		gInst.instanceOffset = inst.hitRecordIndex;
+		gInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV | inst.flags;
 		gInst.accelerationStructureHandle = handle;
 		memcpy(gInst.transform, &transform, sizeof(gInst.transform));
 
@@ -60,12 +63,13 @@ Buffer* TopLevelAS::createInstanceBuffer(const std::vector<Instance>& instances)
 }
 
 TopLevelAS::Instance::Instance(BottomLevelAS* blAS,
-	uint32_t instanceId, uint32_t hitGroup, uint32_t mask,
-	const glm::mat4& transform) {
+	uint32_t instanceId, uint32_t hitRecord, uint32_t mask,
+	const glm::mat4& transform, VkGeometryInstanceFlagsNV flags) {
 
 	this->bottomLevelAS = blAS;
 	this->instanceId = instanceId;
-	this->hitGroupIndex = hitGroup;
+	this->hitRecordIndex = hitRecord;
 	this->mask = mask;
 	this->transform = transform;
+	this->flags = flags;
 }
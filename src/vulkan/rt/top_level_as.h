@@ -7,21 +7,24 @@ class TopLevelAS : public AccelerationStructure {
 	public:
 		struct Instance {
 			Instance(BottomLevelAS* blAS,
-				uint32_t instanceId, uint32_t hitGroup, uint32_t mask,
-				const glm::mat4& transform);
+				uint32_t instanceId, uint32_t hitRecord, uint32_t mask,
+				const glm::mat4& transform, VkGeometryInstanceFlagsNV flags = 0);
 
 			BottomLevelAS* bottomLevelAS;
 			uint32_t instanceId;
-			uint32_t hitGroupIndex;
+			uint32_t hitRecordIndex;
 			uint32_t mask;
 			glm::mat4 transform;
+			// Added to the flags of every instance, which disable triangle culling
+			VkGeometryInstanceFlagsNV flags;
 		};
 
 		TopLevelAS(Device* device, const std::vector<Instance>& instances, bool allowUpdate = false);
 
 		~TopLevelAS();
 
-		void update(const std::vector<Instance>& instances);
+		// Refits the structure to the instances, recorded into the command buffer if there is one
+		void update(const std::vector<Instance>& instances, VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
 
 	private:
 
@@ -33,7 +36,7 @@ class TopLevelAS : public AccelerationStructure {
 			uint32_t instanceId : 24;
 			// Visibility mask
 			uint32_t mask : 8;
-			// Index of the hit group which will be invoked when a ray hits the instance
+			// Index of the hit record in the shader binding table which will be invoked when a ray hits the instance
 			uint32_t instanceOffset : 24;
 			// Instance flags, such as culling
 			uint32_t flags : 8;
@@ -1,52 +1,27 @@
 #include "scene.h"
 #include "rt/raytracing_pipeline.h"
 #include "extensions.h"
+#include "shader_archive.h"
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <filesystem>
+#include <iostream>
 
-Scene::Scene(Device* device) : device(device) {
+Scene::Scene(Device* device, const RaytracingPipeline::Settings& settings) : device(device) {
 
-	// Pipeline
-	pipeline = std::make_unique<RaytracingPipeline>(device);
-
-	// Shaders
-	std::unique_ptr<Shader> shaderMiss(Shader::loadFromFile(device, "shaders/primary.rmiss", Shader::Type::Miss));
-	std::unique_ptr<Shader> shaderShadowMiss(Shader::loadFromFile(device, "shaders/shadow.rmiss", Shader::Type::Miss));
-	std::unique_ptr<Shader> shaderClosestHit(Shader::loadFromFile(device, "shaders/primary.rchit", Shader::Type::ClosestHit));
-	std::unique_ptr<Shader> shaderRayGen(Shader::loadFromFile(device, "shaders/primary.rgen", Shader::Type::RayGen));
-	std::unique_ptr<Shader> shaderLight(Shader::loadFromFile(device, "shaders/light_source.rchit", Shader::Type::ClosestHit));
-	std::unique_ptr<Shader> shaderSphereClosestHit(Shader::loadFromFile(device, "shaders/sphere.rchit", Shader::Type::ClosestHit));
-	std::unique_ptr<Shader> shaderSphereIntersection(Shader::loadFromFile(device, "shaders/sphere.rint", Shader::Type::Intersection));
-
-	// Stages
-	pipeline->addShaderStage(shaderRayGen.get());
-	pipeline->addShaderStage(shaderMiss.get());
-	pipeline->addShaderStage(shaderShadowMiss.get());
-
-	uint32_t hitGroupNormal = pipeline->startHitGroup();
-	pipeline->addHitShaderStage(shaderClosestHit.get());
-	pipeline->endHitGroup();
-
-	uint32_t hitGroupSphere = pipeline->startHitGroup();
-	pipeline->addHitShaderStage(shaderSphereClosestHit.get());
-	pipeline->addHitShaderStage(shaderSphereIntersection.get());
-	pipeline->endHitGroup();
-
-	uint32_t hitGroupLight = pipeline->startHitGroup();
-	pipeline->addHitShaderStage(shaderLight.get());
-	pipeline->endHitGroup();
-
-	pipeline->create();
-	shaderBindingTable.reset(pipeline->generateShaderBindingTable());
+	// Hit groups that do not depend on a material, the material permutations are added on demand
+	uint32_t hitGroupLight = addHitGroup({ "shaders/light_source.rchit", "", {} });
 
 	// Textures
 	auto textureChecker = addTexture("textures/checker.png", VK_FORMAT_R8G8B8A8_UNORM);
 	auto textureMarble = addTexture("textures/marble.png", VK_FORMAT_R8G8B8A8_UNORM);
 	auto textureNormalMap = addTexture("textures/normalmap.png", VK_FORMAT_R8G8B8A8_UNORM);
+	auto textureFence = addTexture("textures/fence.png", VK_FORMAT_R8G8B8A8_UNORM);
 
 	// Materials
 	auto materialFloor = addMaterial({ textureChecker, nullptr, nullptr, nullptr });
 	auto materialCube = addMaterial({ nullptr, textureNormalMap, nullptr, nullptr });
+	auto materialFence = addMaterial({ textureFence, nullptr, textureFence, nullptr });
 
 	// Objects
 	std::shared_ptr<IObject> quad;
@@ -123,28 +98,43 @@ Scene::Scene(Device* device) : device(device) {
 
 	// Floor
 	{
-		floor = addInstance(quad, hitGroupNormal, materialFloor, glm::scale(glm::mat4(1), glm::vec3(6)));
+		floor = addInstance(quad, getHitGroup(quad, materialFloor), materialFloor, glm::scale(glm::mat4(1), glm::vec3(6)));
+	}
+
+	// Alpha tested fence behind the objects
+	{
+		auto transform = glm::translate(glm::mat4(1), glm::vec3(0, -2, 1.5f)) *
+			glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(1, 0, 0)) * glm::scale(glm::mat4(1), glm::vec3(3));
+
+		addInstance(quad, getHitGroup(quad, materialFence), materialFence, transform);
 	}
 
 	// Rotating cube
 	{
-		rotatingCube = addInstance(sphere, hitGroupSphere, materialCube);
+		rotatingCube = addInstance(sphere, getHitGroup(sphere, materialCube), materialCube);
 	}
 
 	// Point light
 	{
 		pointLight = addInstance(cube, hitGroupLight);
 		pointLight->mask = 0x01;
+
+		mainLight = addLight(glm::vec3(0.0f), glm::vec3(12.0f));
 	}
 
+	pipeline = createPipeline(shaders, settings);
+	shaderBindingTable = createShaderBindingTable(pipeline.get());
+
 	buildAccelerationStructure();
+	buildLightTree();
 }
 
 Scene::~Scene() {
 
 }
 
-void Scene::trace() {
+void Scene::trace(VkExtent2D extent, RayGen rayGen) {
+	device->getTracker().validateFlushed("vkCmdTraceRaysNV");
 	pipeline->bind(VK_PIPELINE_BIND_POINT_RAY_TRACING_NV);
 
 	vkCmdBindDescriptorSets(device->getCommandBuffer(), VK_PIPELINE_BIND_POINT_RAY_TRACING_NV,
@@ -154,37 +144,146 @@ void Scene::trace() {
 	auto miss = ShaderBindingTable::EntryType::Miss;
 	auto hitGroup = ShaderBindingTable::EntryType::HitGroup;
 
-	auto ext = device->getSwapchain()->getExtent();
+	// Every frame in flight traces with its own copy of the hit records, which gets the records changed
+	// since the frame slot was last recorded
+	uint32_t frame = (uint32_t) device->getFrameIndex();
+	shaderBindingTable->writeHitGroups(frame);
 
 	VkExt::vkCmdTraceRaysNV(device->getCommandBuffer(),
-		*shaderBindingTable->getBuffer(), shaderBindingTable->getOffset(rg),
+		*shaderBindingTable->getBuffer(), shaderBindingTable->getOffset(rg) + (uint32_t) rayGen * shaderBindingTable->getEntrySize(rg),
 		*shaderBindingTable->getBuffer(), shaderBindingTable->getOffset(miss), shaderBindingTable->getEntrySize(miss),
-		*shaderBindingTable->getBuffer(), shaderBindingTable->getOffset(hitGroup), shaderBindingTable->getEntrySize(hitGroup),
-		VK_NULL_HANDLE, 0, 0, ext.width, ext.height, 1);
+		*shaderBindingTable->getBuffer(), shaderBindingTable->getOffset(hitGroup, frame), shaderBindingTable->getEntrySize(hitGroup),
+		VK_NULL_HANDLE, 0, 0, extent.width, extent.height, 1);
 }
 
-void Scene::updateInstance(std::shared_ptr<Instance> instance) {
+void Scene::setSettings(const RaytracingPipeline::Settings& settings) {
+	std::lock_guard<std::mutex> lock(reloadMutex);
 
-	struct Data {
-		int objectId;
-		int materialId;
-		int _pad[2];
-		glm::mat4 normalMatrix;
-	};
+	// The pipeline keeps every variant it created, so the frames in flight can keep tracing with the old one.
+	// Only the shader binding table holds the group handles of a variant and is replaced
+	device->destroyLater(std::move(shaderBindingTable));
 
-	Data data;
-	data.objectId = instance->object->getIndex();
-	data.materialId = getIndex(materials, instance->material);
-	data.normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance->transform)));
+	pipeline->create(settings);
+	shaderBindingTable = createShaderBindingTable(pipeline.get());
 
-	if (instance->buffer == nullptr) {
-		instance->buffer = createBuffer(sizeof(Data), &data);
-	} else {
-		copyToBuffer(instance->buffer, sizeof(Data), &data);
+	if (pendingReload) {
+		pendingReload->pipeline->create(settings);
+	}
+
+	revision++;
+}
+
+void Scene::reloadShaders(const std::vector<std::string>& files) {
+	std::lock_guard<std::mutex> lock(reloadMutex);
+
+	std::set<std::string> changedFiles = failedReloadFiles;
+	for (const auto& f : files) {
+		changedFiles.insert(std::filesystem::absolute(f).lexically_normal().string());
+	}
+
+	// Build upon a reload that has not been swapped in yet
+	auto reload = std::make_unique<PipelineReload>();
+	reload->shaders = pendingReload ? pendingReload->shaders : shaders;
+
+	bool affected = false;
+	for (const auto& s : reload->shaders) {
+		for (const auto& d : s.second->getDependencies()) {
+			affected |= changedFiles.count(d) > 0;
+		}
+	}
+
+	if (!affected) {
+		return;
+	}
+
+	try {
+		reload->pipeline = createPipeline(reload->shaders, pipeline->getSettings(), changedFiles);
+
+		pendingReload = std::move(reload);
+		failedReloadFiles.clear();
+
+		std::cout << "Shaders reloaded" << std::endl;
+	} catch (const std::exception& e) {
+		failedReloadFiles = changedFiles;
+		std::cout << "Shader reload failed: " << e.what() << std::endl;
+	}
+}
+
+void Scene::applyShaderReload() {
+
+	// Never stall the frame while a reload is being compiled
+	std::unique_lock<std::mutex> lock(reloadMutex, std::try_to_lock);
+
+	if (!lock.owns_lock() || !pendingReload) {
+		return;
 	}
+
+	// The old pipeline and shader binding table might still be in use by the frames in flight
+	device->destroyLater(std::move(pipeline));
+	device->destroyLater(std::move(shaderBindingTable));
+
+	shaders = std::move(pendingReload->shaders);
+	pipeline = std::move(pendingReload->pipeline);
+	shaderBindingTable = createShaderBindingTable(pipeline.get());
+	pendingReload.reset();
+	revision++;
+}
+
+void Scene::beginFrame() {
+	for (const auto& i : instances) {
+		if (i->previousTransform != i->committedTransform) {
+			i->previousTransform = i->committedTransform;
+			writeHitRecord(*i);
+		}
+	}
+}
+
+void Scene::updateInstance(std::shared_ptr<Instance> instance) {
+
+	if (instance->transform == instance->committedTransform) {
+		return;
+	}
+
+	instance->committedTransform = instance->transform;
+	revision++;
+
+	writeHitRecord(*instance);
 }
 
 void Scene::updateMaterial(std::shared_ptr<Material> material) {
+	uint32_t features = getMaterialFeatures(*material);
+
+	if (features != material->features) {
+		std::vector<std::shared_ptr<Instance>> affected;
+
+		for (const auto& i : instances) {
+			auto type = i->object->getType();
+
+			if (i->material == material && getSupportedFeatures(type, features) != getSupportedFeatures(type, material->features)) {
+				affected.push_back(i);
+			}
+		}
+
+		// Permutations are compiled into the pipeline and selected by the hit records
+		if (!affected.empty() && pipeline) {
+			throw std::logic_error("Cannot change the features of a material used by instances after the pipeline was created");
+		}
+
+		uint32_t previous = material->features;
+		material->features = features;
+
+		// Instances that use the permutation of the old features switch to the new one, custom hit groups are kept
+		for (const auto& i : affected) {
+			auto it = permutations.find(std::make_pair(i->object->getType(), getSupportedFeatures(i->object->getType(), previous)));
+
+			if (it != permutations.end() && it->second == i->hitGroup) {
+				i->hitGroup = getHitGroup(i->object, material);
+			}
+
+			i->shadowHitGroup = getShadowHitGroup(i->object, material);
+		}
+	}
+
 	struct Data {
 		int textureId[4];
 		glm::vec4 color;
@@ -202,13 +301,24 @@ void Scene::updateMaterial(std::shared_ptr<Material> material) {
 	} else {
 		copyToBuffer(material->buffer, sizeof(Data), &data);
 	}
+
+	revision++;
+
+	for (const auto& i : instances) {
+		if (i->material == material) {
+			writeHitRecord(*i);
+		}
+	}
 }
 
 std::shared_ptr<Scene::IObject> Scene::addMesh(const std::vector<Vertex>& vertices,
 	const std::vector<uint32_t>& indices) {
 
-	auto vb = createBuffer(sizeof(Vertex) * vertices.size(), vertices.data());
-	auto ib = createBuffer(sizeof(uint32_t) * indices.size(), indices.data());
+	// The bottom level structure is built from the buffers on the compute queue
+	auto vb = createBuffer(sizeof(Vertex) * vertices.size(), vertices.data(),
+		Device::QueueType::Compute, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV);
+	auto ib = createBuffer(sizeof(uint32_t) * indices.size(), indices.data(),
+		Device::QueueType::Compute, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV);
 	auto blas = std::make_unique<BottomLevelAS>(device,
 		vb.get(), (uint32_t) vertices.size(), sizeof(Vertex),
 		ib.get(), (uint32_t) indices.size());
@@ -249,62 +359,434 @@ std::shared_ptr<Scene::Material> Scene::addMaterial(const std::array<std::shared
 		mat->textures[i] = textures[i];
 	}
 
+	// Also determines the features
 	updateMaterial(mat);
 
 	materials.push_back(mat);
 	return mat;
 }
 
+uint32_t Scene::getHitGroup(const std::shared_ptr<IObject>& object, const std::shared_ptr<Material>& material) {
+
+	if (pipeline) {
+		throw std::logic_error("Cannot add shader permutations after the pipeline was created");
+	}
+
+	uint32_t features = getSupportedFeatures(object, material);
+	auto key = std::make_pair(object->getType(), features);
+
+	auto it = permutations.find(key);
+	if (it != permutations.end()) {
+		return it->second;
+	}
+
+	HitGroup hitGroup;
+	hitGroup.defines = getMaterialDefines(features);
+
+	switch (object->getType()) {
+		case IObject::Type::Mesh:
+			hitGroup.closestHit = "shaders/primary.rchit";
+			break;
+
+		case IObject::Type::Sphere:
+			hitGroup.closestHit = "shaders/sphere.rchit";
+			hitGroup.intersection = "shaders/sphere.rint";
+			break;
+	}
+
+	if (features & MATERIAL_FEATURE_ALPHA_TEST) {
+		hitGroup.anyHit = "shaders/alpha_test.rahit";
+	}
+
+	uint32_t index = addHitGroup(hitGroup);
+	permutations[key] = index;
+
+	return index;
+}
+
+uint32_t Scene::getShadowHitGroup(const std::shared_ptr<IObject>& object, const std::shared_ptr<Material>& material) {
+
+	bool alphaTest = (getSupportedFeatures(object, material) & MATERIAL_FEATURE_ALPHA_TEST) != 0;
+	auto key = std::make_pair(object->getType(), alphaTest);
+
+	auto it = shadowPermutations.find(key);
+	if (it != shadowPermutations.end()) {
+		return it->second;
+	}
+
+	// Opaque triangles need no shaders at all, shadow rays skip the closest hit shader
+	HitGroup hitGroup;
+
+	if (object->getType() == IObject::Type::Sphere) {
+		hitGroup.intersection = "shaders/sphere.rint";
+	}
+
+	if (alphaTest) {
+		hitGroup.anyHit = "shaders/alpha_test.rahit";
+	}
+
+	uint32_t index = addHitGroup(hitGroup);
+	shadowPermutations[key] = index;
+
+	return index;
+}
+
+uint32_t Scene::getSupportedFeatures(const std::shared_ptr<IObject>& object, const std::shared_ptr<Material>& material) {
+	return getSupportedFeatures(object->getType(), material ? material->features : 0);
+}
+
+uint32_t Scene::getSupportedFeatures(IObject::Type type, uint32_t features) {
+
+	// The any-hit shader reconstructs texture coordinates from triangle barycentrics
+	if (type != IObject::Type::Mesh) {
+		features &= ~MATERIAL_FEATURE_ALPHA_TEST;
+	}
+
+	return features;
+}
+
 std::shared_ptr<Scene::Instance> Scene::addInstance(const std::shared_ptr<IObject>& object,
 	uint32_t hitGroup, const std::shared_ptr<Material>& material,
 	const glm::mat4& transform, uint32_t mask) {
 
+	if (shaderBindingTable) {
+		throw std::logic_error("Cannot add instances after the shader binding table was created");
+	}
+
 	auto inst = std::make_shared<Instance>();
 	inst->index = (uint32_t) instances.size();
 	inst->object = object;
 	inst->material = material;
 	inst->transform = transform;
+	inst->committedTransform = transform;
+	inst->previousTransform = transform;
 	inst->hitGroup = hitGroup;
+	inst->shadowHitGroup = getShadowHitGroup(object, material);
 	inst->mask = mask;
-	updateInstance(inst);
 
 	instances.push_back(inst);
 	return inst;
 }
 
-void Scene::buildAccelerationStructure(bool updateOnly) {
+void Scene::buildAccelerationStructure(bool updateOnly, VkCommandBuffer commandBuffer) {
 
 	std::vector<TopLevelAS::Instance> instances;
 	for (const auto& i : this->instances) {
+
+		// Bottom level geometry is opaque, so only alpha tested instances invoke any-hit shaders
+		VkGeometryInstanceFlagsNV flags = (getSupportedFeatures(i->object, i->material) & MATERIAL_FEATURE_ALPHA_TEST) ?
+			VK_GEOMETRY_INSTANCE_FORCE_NO_OPAQUE_BIT_NV : 0;
+
 		instances.push_back(
-			TopLevelAS::Instance(i->object->getBottomLevelAS(), (uint32_t) i->index, i->hitGroup, i->mask, i->transform)
+			TopLevelAS::Instance(i->object->getBottomLevelAS(), i->index, i->index * RAY_TYPE_COUNT, i->mask, i->transform, flags)
 		);
 	}
 
 	if (updateOnly && topLevelAS.get()) {
-		topLevelAS->update(instances);
+		topLevelAS->update(instances, commandBuffer);
 	} else {
+		device->destroyLater(std::move(topLevelAS));
 		topLevelAS = std::make_unique<TopLevelAS>(device, instances, true);
 	}
 }
 
-std::unique_ptr<Buffer> Scene::createBuffer(VkDeviceSize size, const void* data) {
+std::shared_ptr<Scene::Light> Scene::addLight(const glm::vec3& position, const glm::vec3& intensity) {
+
+	if (!lightBuffers.empty()) {
+		throw std::logic_error("Lights have to be added before the light tree is built");
+	}
+
+	auto light = std::make_shared<Light>();
+	light->index = (uint32_t) lights.size();
+	light->position = position;
+	light->intensity = intensity;
+
+	lights.push_back(light);
+	lightData.push_back(glm::vec4(position, 1.0f));
+	lightData.push_back(glm::vec4(intensity, 0.0f));
+	lightTreeDirty = true;
+
+	return light;
+}
+
+void Scene::updateLight(std::shared_ptr<Light> light) {
+
+	auto position = glm::vec4(light->position, 1.0f);
+	auto intensity = glm::vec4(light->intensity, 0.0f);
+
+	if (lightData[2 * light->index] == position && lightData[2 * light->index + 1] == intensity) {
+		return;
+	}
+
+	lightData[2 * light->index] = position;
+	lightData[2 * light->index + 1] = intensity;
+	lightTreeDirty = true;
+	revision++;
+}
+
+void Scene::buildLightTree() {
+
+	if (!lightTreeDirty) {
+		return;
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<float> powers;
+
+	// Lights are importance sampled by the luminance of their intensity
+	for (size_t i = 0; i < lightData.size(); i += 2) {
+		positions.push_back(glm::vec3(lightData[i]));
+		powers.push_back(glm::dot(glm::vec3(lightData[i + 1]), glm::vec3(0.2126f, 0.7152f, 0.0722f)));
+	}
+
+	lightTree.build(positions, powers);
+	builtLightData = lightData;
+	lightTreeDirty = false;
+
+	if (lightBuffers.empty()) {
+		const auto& nodes = lightTree.getNodes();
+
+		for (int i = 0; i < device->getFrameCount(); i++) {
+			// Without lights the buffer still needs a valid size
+			lightBuffers.push_back(std::make_unique<Buffer>(device, std::max<VkDeviceSize>(lightData.size(), 2) * sizeof(glm::vec4),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+			lightTreeBuffers.push_back(std::make_unique<Buffer>(device, nodes.size() * sizeof(LightTree::Node),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+		}
+	}
+
+	// Frames in flight may still descend the old tree, whose nodes a rebuild can reorder. Every frame gets
+	// the new one when it is recorded next
+	staleLightBuffers.assign(lightBuffers.size(), true);
+}
+
+void Scene::writeLightBuffers() {
+	uint32_t frame = (uint32_t) device->getFrameIndex();
+
+	if (!staleLightBuffers.at(frame)) {
+		return;
+	}
+
+	if (!builtLightData.empty()) {
+		lightBuffers[frame]->fill(builtLightData.data());
+	}
+
+	lightTreeBuffers[frame]->fill(lightTree.getNodes().data());
+	staleLightBuffers[frame] = false;
+}
+
+uint32_t Scene::addHitGroup(const HitGroup& hitGroup) {
+	hitGroups.push_back(hitGroup);
+	return (uint32_t) hitGroups.size() - 1;
+}
+
+std::unique_ptr<RaytracingPipeline> Scene::createPipeline(ShaderMap& shaders,
+	const RaytracingPipeline::Settings& settings, const std::set<std::string>& changedFiles) {
+
+	auto pipeline = std::make_unique<RaytracingPipeline>(device);
+
+	auto addStage = [&](const std::string& path, Shader::Type type, const Shader::Defines& defines = {}) {
+		auto shader = getShader(shaders, path, type, defines, changedFiles);
+
+		if (type == Shader::Type::RayGen || type == Shader::Type::Miss) {
+			pipeline->addShaderStage(shader.get());
+		} else {
+			pipeline->addHitShaderStage(shader.get());
+		}
+	};
+
+	// General stages
+	addStage("shaders/primary.rgen", Shader::Type::RayGen);
+	addStage("shaders/restir.rgen", Shader::Type::RayGen);
+	addStage("shaders/wavefront_trace.rgen", Shader::Type::RayGen);
+	addStage("shaders/wavefront_shadow.rgen", Shader::Type::RayGen);
+	addStage("shaders/primary.rmiss", Shader::Type::Miss);
+	addStage("shaders/shadow.rmiss", Shader::Type::Miss);
+
+	// Hit groups, their indices match the order in which they were added
+	for (const auto& g : hitGroups) {
+		pipeline->startHitGroup();
+
+		if (!g.closestHit.empty()) {
+			addStage(g.closestHit, Shader::Type::ClosestHit, g.defines);
+		}
+
+		// The any-hit shader only reads the alpha mask, all permutations share it
+		if (!g.anyHit.empty()) {
+			addStage(g.anyHit, Shader::Type::AnyHit, getMaterialDefines(MATERIAL_FEATURE_ALPHA_TEST));
+		}
+
+		// Intersection shaders do not depend on the material
+		if (!g.intersection.empty()) {
+			addStage(g.intersection, Shader::Type::Intersection);
+		}
+
+		pipeline->endHitGroup();
+	}
+
+	pipeline->create(settings);
+	return pipeline;
+}
+
+std::unique_ptr<ShaderBindingTable> Scene::createShaderBindingTable(RaytracingPipeline* pipeline) {
+	std::vector<RaytracingPipeline::HitRecord> records;
+
+	for (const auto& i : instances) {
+		auto data = getHitRecordData(*i);
+
+		records.push_back({ i->hitGroup, data });
+		records.push_back({ i->shadowHitGroup, data });
+	}
+
+	return std::unique_ptr<ShaderBindingTable>(pipeline->generateShaderBindingTable(records, device->getFrameCount()));
+}
+
+void Scene::writeHitRecord(const Instance& instance) {
+
+	// Instances are written all at once when the shader binding table is created, updates only reach the
+	// copies of the frames recorded afterwards
+	if (!shaderBindingTable) {
+		return;
+	}
+
+	auto data = getHitRecordData(instance);
+
+	for (uint32_t rayType = 0; rayType < RAY_TYPE_COUNT; rayType++) {
+		shaderBindingTable->updateEntry(ShaderBindingTable::EntryType::HitGroup, instance.index * RAY_TYPE_COUNT + rayType,
+			data.data(), data.size());
+	}
+}
+
+ByteArray Scene::getHitRecordData(const Instance& instance) {
+
+	// Matches the HitRecord block in shaders/common/hit_record.glsl
+	struct Data {
+		int objectId;
+		int materialId;
+		int _pad[2];
+		glm::mat3x4 normalMatrix;
+		glm::mat4 prevObjectToWorld;
+		int textureId[4];
+		glm::vec4 color;
+	};
+
+	Data data = {};
+	data.objectId = instance.object->getIndex();
+	data.materialId = getIndex(materials, instance.material);
+	data.normalMatrix = glm::mat3x4(glm::mat4(glm::transpose(glm::inverse(glm::mat3(instance.transform)))));
+	data.prevObjectToWorld = instance.previousTransform;
+	data.color = instance.material ? instance.material->color : glm::vec4(1);
+
+	for (size_t i = 0; i < 4; i++) {
+		data.textureId[i] = instance.material ? getIndex(textures, instance.material->textures[i]) : -1;
+	}
+
+	ByteArray bytes(sizeof(Data));
+	memcpy(bytes.data(), &data, sizeof(Data));
+	return bytes;
+}
+
+std::shared_ptr<Shader> Scene::getShader(ShaderMap& shaders, const std::string& path, Shader::Type type,
+	const Shader::Defines& defines, const std::set<std::string>& changedFiles) {
+
+	auto& shader = shaders[ShaderArchive::getKey(path, defines)];
+	bool changed = !shader;
+
+	if (shader) {
+		for (const auto& d : shader->getDependencies()) {
+			changed |= changedFiles.count(d) > 0;
+		}
+	}
+
+	// A reload has to see the edited source, the shader archive only holds what was baked
+	if (changed && changedFiles.empty()) {
+		shader.reset(Shader::loadFromFile(device, path, type, defines));
+	} else if (changed) {
+		shader.reset(Shader::compileFromFile(device, path, type, defines));
+	}
+
+	return shader;
+}
+
+uint32_t Scene::getMaterialFeatures(const Material& material) {
+	uint32_t features = 0;
+
+	if (material.textures[0]) {
+		features |= MATERIAL_FEATURE_ALBEDO_MAP;
+	}
+
+	if (material.textures[1]) {
+		features |= MATERIAL_FEATURE_NORMAL_MAP;
+	}
+
+	// Reflections are traced if the diffuse color is white, which albedo maps can only tell at runtime
+	if (material.textures[0] || material.color == glm::vec4(1.0f)) {
+		features |= MATERIAL_FEATURE_REFLECTIVE;
+	}
+
+	if (material.textures[2]) {
+		features |= MATERIAL_FEATURE_ALPHA_TEST;
+	}
+
+	return features;
+}
+
+std::unique_ptr<Buffer> Scene::createBuffer(VkDeviceSize size, const void* data, Device::QueueType user,
+	VkAccessFlags access) {
 
 	auto buffer = std::make_unique<Buffer>(device, size,
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	copyToBuffer(buffer, size, data);
+	auto localBuffer = new Buffer(device, size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	localBuffer->fill(data);
+
+	// No frame reads a new buffer yet, so it is uploaded on the transfer queue and handed to its user
+	auto commandBuffer = device->beginSingleTimeCommands(Device::QueueType::Transfer);
+
+	VkBufferCopy region = {};
+	region.size = size;
+	vkCmdCopyBuffer(commandBuffer, *localBuffer, *buffer, 1, &region);
+
+	device->transferOwnership(commandBuffer, *buffer, Device::QueueType::Transfer, user,
+		VK_ACCESS_TRANSFER_WRITE_BIT, access);
+
+	// The submission acquiring the buffer waits for the upload, nothing else does
+	auto job = device->submitSingleTimeCommands(commandBuffer, Device::QueueType::Transfer);
+
+	device->getScheduler().destroyAfter(job, [localBuffer]() {
+		delete localBuffer;
+	});
 
 	return buffer;
 }
 
 void Scene::copyToBuffer(const std::unique_ptr<Buffer>& buffer, VkDeviceSize size, const void* data) {
 
-	Buffer localBuffer(device, size,
+	auto localBuffer = std::make_unique<Buffer>(device, size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	localBuffer.fill(data);
-	localBuffer.copyTo(buffer.get());
+	localBuffer->fill(data);
+
+	// The barriers order the copy after the frames reading the buffer before and before those reading it after,
+	// which are all submitted to the graphics queue, so nothing has to wait for it
+	auto commandBuffer = device->beginSingleTimeCommands();
+
+	device->bufferBarrier(commandBuffer, *buffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	VkBufferCopy region = {};
+	region.size = size;
+	vkCmdCopyBuffer(commandBuffer, *localBuffer, *buffer, 1, &region);
+
+	device->bufferBarrier(commandBuffer, *buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	device->submitSingleTimeCommands(commandBuffer);
+	device->destroyLater(std::move(localBuffer));
 }
\ No newline at end of file
@@ -4,16 +4,29 @@
 #include "buffer.h"
 #include "device.h"
 #include "texture.h"
+#include "material_features.h"
+#include "light_tree.h"
 #include "rt/top_level_as.h"
 #include "rt/raytracing_pipeline.h"
 #include "rt/shader_binding_table.h"
 
+#include <map>
+#include <set>
+#include <mutex>
+
 class Scene {
 
 	public:
 		class IObject {
 			public:
+				enum class Type {
+					Mesh,
+					Sphere
+				};
+
 				virtual ~IObject() = default;
+
+				virtual Type getType() const = 0;
 				
 				virtual BottomLevelAS* getBottomLevelAS() = 0;
 
@@ -26,6 +39,10 @@ class Scene {
 					std::unique_ptr<Buffer>& vertexBuffer, std::unique_ptr<Buffer>& indexBuffer) 
 					: index(index), blAS(std::move(blAS)), vertexBuffer(std::move(vertexBuffer)), indexBuffer(std::move(indexBuffer)) {}
 
+				Type getType() const {
+					return Type::Mesh;
+				}
+
 				uint32_t getIndex() const {
 					return index;
 				}
@@ -57,6 +74,10 @@ class Scene {
 				Sphere(uint32_t index, std::unique_ptr<BottomLevelAS>& blAS, std::unique_ptr<Buffer>& buffer)
 					: index(index), blAS(std::move(blAS)), buffer(std::move(buffer)) {}
 
+				Type getType() const {
+					return Type::Sphere;
+				}
+
 				uint32_t getIndex() const {
 					return index;
 				}
@@ -79,30 +100,90 @@ class Scene {
 
 		struct Material {
 			std::unique_ptr<Buffer> buffer;
+			// Albedo map, normal map and alpha mask
 			std::array<std::shared_ptr<Texture>, 4> textures;
 			glm::vec4 color;
+			uint32_t features = 0;
 		};
 
+		// Every instance has its own hit record per ray type in the shader binding table, at
+		// index * RAY_TYPE_COUNT + the ray type
 		struct Instance {
 			uint32_t index;
 			std::shared_ptr<IObject> object;
 			std::shared_ptr<Material> material;
-			std::unique_ptr<Buffer> buffer;
 			glm::mat4 transform;
+			glm::mat4 committedTransform;
+			// Transform of the last frame, for motion vectors
+			glm::mat4 previousTransform;
 			uint32_t hitGroup;
+			// Hit group of shadow rays, without closest hit shader
+			uint32_t shadowHitGroup;
 			uint32_t mask;
 		};
 
-		Scene(Device* device);
+		// Ray types, the sbtRecordOffset of traceNV(). Have to match RAY_TYPE_* in shaders/common/constants.glsl
+		static const uint32_t RAY_TYPE_PRIMARY = 0;
+
+		static const uint32_t RAY_TYPE_SHADOW = 1;
+
+		static const uint32_t RAY_TYPE_COUNT = 2;
+
+		// Point light sampled by next event estimation, independent of the instances showing it
+		struct Light {
+			uint32_t index;
+			glm::vec3 position;
+			glm::vec3 intensity;
+		};
+
+		Scene(Device* device, const RaytracingPipeline::Settings& settings = RaytracingPipeline::Settings());
 
 		~Scene();
 
-		void trace();
+		// Ray generation shaders of the pipeline, in the order they are added
+		enum class RayGen {
+			Primary,
+			// Spatial reuse and shadow ray of ReSTIR, shaders/restir.rgen
+			LightResampling,
+			// Stages of the wavefront path tracer, see WavefrontScheduler
+			WavefrontTrace,
+			WavefrontShadow
+		};
+
+		void trace(VkExtent2D extent, RayGen rayGen = RayGen::Primary);
+
+		// Switch to the pipeline variant for the given settings, creating it if necessary
+		void setSettings(const RaytracingPipeline::Settings& settings);
 
+		const RaytracingPipeline::Settings& getSettings() const {
+			return pipeline->getSettings();
+		}
+
+		// Recompiles all shaders depending on one of the given files and builds a new pipeline and
+		// shader binding table from them. Meant to be called from a background thread, the result
+		// is swapped in by the next applyShaderReload(). If compilation fails, the current
+		// pipeline stays active
+		void reloadShaders(const std::vector<std::string>& files);
+
+		// Swaps in the pipeline of a finished reload, to be called between frames
+		void applyShaderReload();
+
+		// Makes the current transforms the previous ones of the new frame, to be called once per frame
+		// before instances are updated
+		void beginFrame();
+
+		// Rewrites the hit record of the instance if its transform changed
 		void updateInstance(std::shared_ptr<Instance> instance);
 
+		// Rewrites the material buffer and the hit records of all instances using the material. Changes that
+		// select another shader permutation for these instances are only possible before the pipeline exists
 		void updateMaterial(std::shared_ptr<Material> material);
 
+		// Incremented whenever anything affecting the rendered image changes, e.g. to restart accumulation
+		uint32_t getRevision() const {
+			return revision;
+		}
+
 		std::shared_ptr<IObject> addMesh(const std::vector<Vertex>& vertices, 
 			const std::vector<uint32_t>& indices);
 
@@ -113,11 +194,45 @@ class Scene {
 		std::shared_ptr<Material> addMaterial(const std::array<std::shared_ptr<Texture>, 4>& textures,
 			const glm::vec4& color = glm::vec4(1));
 
+		// Returns the hit group of the shader permutation matching the object type and material features.
+		// Alpha masks are only supported on meshes
+		uint32_t getHitGroup(const std::shared_ptr<IObject>& object, const std::shared_ptr<Material>& material);
+
 		std::shared_ptr<Instance> addInstance(const std::shared_ptr<IObject>& object, uint32_t hitGroup,
 			const std::shared_ptr<Material>& material = nullptr, const glm::mat4& transform = glm::mat4(1.0f),
 			uint32_t mask = 0xff);
 
-		void buildAccelerationStructure(bool updateOnly = false);
+		// Updates can be recorded into a command buffer of the frame, which may happen on another thread than
+		// the one recording the frame
+		void buildAccelerationStructure(bool updateOnly = false, VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
+
+		// Lights have to be added before the light tree is built for the first time, since its
+		// buffers are sized for them
+		std::shared_ptr<Light> addLight(const glm::vec3& position, const glm::vec3& intensity);
+
+		// Marks the light tree for a rebuild if the light changed
+		void updateLight(std::shared_ptr<Light> light);
+
+		// Rebuilds the light tree if a light changed. The light buffers of the frames only get it in
+		// writeLightBuffers()
+		void buildLightTree();
+
+		// Writes the lights and the light tree into the buffers of the current frame if they are outdated,
+		// to be called once frameBegin() waited for the frame slot
+		void writeLightBuffers();
+
+		// Every frame in flight reads its own light buffers, since lights can move every frame
+		const auto& getLightBuffer(uint32_t frame) const {
+			return lightBuffers.at(frame);
+		}
+
+		const auto& getLightTreeBuffer(uint32_t frame) const {
+			return lightTreeBuffers.at(frame);
+		}
+
+		const auto& getLights() const {
+			return lights;
+		}
 
 		const auto& getAccelerationStructure() const {
 			return topLevelAS;
@@ -149,10 +264,58 @@ class Scene {
 
 		std::shared_ptr<Scene::Instance> pointLight;
 
+		std::shared_ptr<Scene::Light> mainLight;
+
 	private:
 
-		std::unique_ptr<Buffer> createBuffer(VkDeviceSize size, const void* data);
+		struct HitGroup {
+			std::string closestHit;
+			std::string intersection;
+			Shader::Defines defines;
+			std::string anyHit;
+		};
+
+		typedef std::map<std::string, std::shared_ptr<Shader>> ShaderMap;
+
+		// Pipeline built by a shader reload, waiting to be swapped in. Its shader binding table is
+		// created on the render thread, since hit records change with the instances
+		struct PipelineReload {
+			ShaderMap shaders;
+			std::unique_ptr<RaytracingPipeline> pipeline;
+		};
+
+		uint32_t addHitGroup(const HitGroup& hitGroup);
+
+		// Shadow rays only need the any-hit shader of alpha tested materials
+		uint32_t getShadowHitGroup(const std::shared_ptr<IObject>& object, const std::shared_ptr<Material>& material);
+
+		// Material features of the hit group permutation, without the ones the object type does not support
+		static uint32_t getSupportedFeatures(const std::shared_ptr<IObject>& object, const std::shared_ptr<Material>& material);
+
+		static uint32_t getSupportedFeatures(IObject::Type type, uint32_t features);
+
+		// Creates a pipeline with all hit groups. Shaders are taken from the given map unless they
+		// are missing or depend on one of the changed files, in which case they are (re)compiled
+		std::unique_ptr<RaytracingPipeline> createPipeline(ShaderMap& shaders,
+			const RaytracingPipeline::Settings& settings, const std::set<std::string>& changedFiles = {});
+
+		std::shared_ptr<Shader> getShader(ShaderMap& shaders, const std::string& path, Shader::Type type,
+			const Shader::Defines& defines, const std::set<std::string>& changedFiles);
+
+		std::unique_ptr<ShaderBindingTable> createShaderBindingTable(RaytracingPipeline* pipeline);
+
+		void writeHitRecord(const Instance& instance);
+
+		// Inline data of the hit record of an instance, read by the hit shaders through shaderRecordNV
+		ByteArray getHitRecordData(const Instance& instance);
+
+		static uint32_t getMaterialFeatures(const Material& material);
+
+		// Uploads a new buffer through the transfer queue and hands it to the queue type reading it first
+		std::unique_ptr<Buffer> createBuffer(VkDeviceSize size, const void* data,
+			Device::QueueType user = Device::QueueType::Graphics, VkAccessFlags access = VK_ACCESS_SHADER_READ_BIT);
 
+		// Updates a buffer on the graphics queue, after the frames in flight that read it
 		void copyToBuffer(const std::unique_ptr<Buffer>& buffer, VkDeviceSize size, const void* data);
 
 		template <class T>
@@ -175,7 +338,50 @@ class Scene {
 
 		std::unique_ptr<TopLevelAS> topLevelAS;
 
+		std::vector<std::shared_ptr<Light>> lights;
+
+		// Lights as read by the shaders, also used to detect changes
+		std::vector<glm::vec4> lightData;
+
+		LightTree lightTree;
+
+		bool lightTreeDirty = true;
+
+		// Lights the tree was built for, written to the light buffers with it
+		std::vector<glm::vec4> builtLightData;
+
+		// Host visible, one per frame in flight
+		std::vector<std::unique_ptr<Buffer>> lightBuffers;
+
+		std::vector<std::unique_ptr<Buffer>> lightTreeBuffers;
+
+		// Frames whose light buffers miss the last build of the light tree
+		std::vector<bool> staleLightBuffers;
+
+		// Hit groups in the order they are added to the pipeline
+		std::vector<HitGroup> hitGroups;
+
+		// Hit groups of the shader permutations, keyed by object type and material features
+		std::map<std::pair<IObject::Type, uint32_t>, uint32_t> permutations;
+
+		// Shadow hit groups, keyed by object type and whether the material is alpha tested
+		std::map<std::pair<IObject::Type, bool>, uint32_t> shadowPermutations;
+
+		// Shader modules keyed by path and defines. They have to outlive the pipeline, so
+		// further variants can be created
+		ShaderMap shaders;
+
 		std::unique_ptr<RaytracingPipeline> pipeline;
 
 		std::unique_ptr<ShaderBindingTable> shaderBindingTable;
+
+		uint32_t revision = 0;
+
+		// Guards the pipeline state shared with the reload thread
+		std::mutex reloadMutex;
+
+		std::unique_ptr<PipelineReload> pendingReload;
+
+		// Changed files of reloads that failed, so they are recompiled by the next attempt
+		std::set<std::string> failedReloadFiles;
 };
\ No newline at end of file
@@ -1,78 +1,109 @@
 #include "shader.h"
+#include "shader_archive.h"
 #include "device.h"
 
-#include <shaderc/shaderc.hpp>
+#ifndef SHADER_ARCHIVE_ONLY
+#include "shader_compiler.h"
+#endif
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 
-class Includer : public shaderc::CompileOptions::IncluderInterface {
+static const char* SHADER_ARCHIVE_PATH = "shaders.spva";
 
-	private:
-		struct Source {
-			std::string path, content;
-		};
+// Loaded once on first use, an archive that does not exist simply contains no modules
+static const ShaderArchive& getArchive() {
+	static ShaderArchive archive = []() {
+		ShaderArchive archive;
 
-	public:
-		// Handles shaderc_include_resolver_fn callbacks.
-		shaderc_include_result* GetInclude(const char* requested_source,
-			shaderc_include_type type,
-			const char* requesting_source,
-			size_t include_depth) {
+		if (std::filesystem::exists(SHADER_ARCHIVE_PATH)) {
+			try {
+				archive.load(SHADER_ARCHIVE_PATH);
+			} catch (const std::exception& e) {
+				std::cout << e.what() << std::endl;
+			}
+		}
 
-			auto rs = new shaderc_include_result();
-			*rs = {};
+		return archive;
+	}();
 
-			auto path = std::filesystem::path(requesting_source)
-				.parent_path()
-				.append(requested_source);
+	return archive;
+}
 
-			std::ifstream f(path);
-			if (!f.is_open()) {
-				rs->source_name = "";
-				rs->content = "File not found";
-				return rs;
-			}
+#ifndef SHADER_ARCHIVE_ONLY
 
-			std::stringstream buffer;
-			buffer << f.rdbuf();
+// Whether a source of the module was edited after the archive was baked. Missing sources keep the baked module
+static bool isOutdated(const ShaderArchive::Module& module) {
+	std::error_code error;
+	auto archiveTime = std::filesystem::last_write_time(SHADER_ARCHIVE_PATH, error);
 
-			auto src = std::make_unique<Source>();
-			src->path = std::filesystem::absolute(path).string();
-			src->content = buffer.str();
+	if (error) {
+		return false;
+	}
 
-			rs->source_name = src->path.c_str();
-			rs->source_name_length = src->path.length();
-			rs->content = src->content.c_str();
-			rs->content_length = src->content.length();
+	for (const auto& d : module.dependencies) {
+		auto time = std::filesystem::last_write_time(d, error);
 
-			sources.push_back(std::move(src));
-			return rs;
+		if (!error && time > archiveTime) {
+			return true;
 		}
+	}
 
-		// Handles shaderc_include_result_release_fn callbacks.
-		void ReleaseInclude(shaderc_include_result* data) {
-			delete data;
-		}
+	return false;
+}
 
-	private:
+static shaderc_shader_kind getKind(Shader::Type type) {
+	switch (type) {
+		case Shader::Type::Vertex:
+			return shaderc_vertex_shader;
+		case Shader::Type::Fragment:
+			return shaderc_fragment_shader;
+		case Shader::Type::RayGen:
+			return shaderc_raygen_shader;
+		case Shader::Type::AnyHit:
+			return shaderc_anyhit_shader;
+		case Shader::Type::ClosestHit:
+			return shaderc_closesthit_shader;
+		case Shader::Type::Miss:
+			return shaderc_miss_shader;
+		case Shader::Type::Intersection:
+			return shaderc_intersection_shader;
+		case Shader::Type::Compute:
+			return shaderc_compute_shader;
+		case Shader::Type::Callable:
+		default:
+			return shaderc_callable_shader;
+	}
+}
+
+Shader::Shader(Device* device, const std::string& name, const std::string& src, Type type, const Defines& defines)
+	: device(device), type(type) {
+
+	auto result = ShaderCompiler::compile(name, src, getKind(type), defines);
+	dependencies = result.dependencies;
+
+	createModule(result.code);
+}
 
-		std::vector<std::unique_ptr<Source>> sources;
-};
+#endif
 
-Shader::Shader(Device* device, const std::string& name, const std::string& src, Type type) : device(device), type(type) {
-	shaderc::Compiler compiler;
-	shaderc::CompileOptions options;
-	std::unique_ptr<shaderc::CompileOptions::IncluderInterface> includer = std::make_unique<Includer>();
+Shader::Shader(Device* device, const std::vector<uint32_t>& code, Type type, const std::vector<std::string>& dependencies)
+	: device(device), type(type) {
 
-	options.SetIncluder(std::move(includer));
-	auto spv = compile(name, prepare(name, src, compiler, options), compiler, options);
+	for (const auto& d : dependencies) {
+		this->dependencies.push_back(std::filesystem::absolute(d).lexically_normal().string());
+	}
+
+	createModule(code);
+}
 
+void Shader::createModule(const std::vector<uint32_t>& code) {
 	VkShaderModuleCreateInfo moduleInfo = {};
 	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	moduleInfo.codeSize = spv.size() * sizeof(uint32_t);
-	moduleInfo.pCode = spv.data();
+	moduleInfo.codeSize = code.size() * sizeof(uint32_t);
+	moduleInfo.pCode = code.data();
 	
 	if (vkCreateShaderModule(*device, &moduleInfo, nullptr, &module) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create shader module");
@@ -88,50 +119,6 @@ Shader::~Shader() {
 	vkDestroyShaderModule(*device, module, nullptr);
 }
 
-std::string Shader::prepare(const std::string& name, const std::string& src, shaderc::Compiler& compiler, shaderc::CompileOptions& options) {
-	auto result = compiler.PreprocessGlsl(src, getKind(), name.c_str(), options);
-
-	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-		std::cout << result.GetErrorMessage() << std::endl;
-		throw std::runtime_error("Failed to prepare shader");
-	}
-
-	return { result.begin(), result.end() };
-}
-
-std::vector<uint32_t> Shader::compile(const std::string& name, const std::string& src, shaderc::Compiler& compiler, shaderc::CompileOptions& options) {
-	auto result = compiler.CompileGlslToSpv(src, getKind(), name.c_str(), "main", options);
-
-	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-		std::cout << result.GetErrorMessage() << std::endl;
-		throw std::runtime_error("Failed to compile shader");
-	}
-
-	return { result.begin(), result.end() };
-}
-
-shaderc_shader_kind Shader::getKind() {
-	switch (type) {
-		case Type::Vertex:
-			return shaderc_vertex_shader;
-		case Type::Fragment:
-			return shaderc_fragment_shader;
-		case Type::RayGen:
-			return shaderc_raygen_shader;
-		case Type::AnyHit:
-			return shaderc_anyhit_shader;
-		case Type::ClosestHit:
-			return shaderc_closesthit_shader;
-		case Type::Miss:
-			return shaderc_miss_shader;
-		case Type::Intersection:
-			return shaderc_intersection_shader;
-		case Type::Callable:
-		default:
-			return shaderc_callable_shader;
-	}
-}
-
 VkShaderStageFlagBits Shader::getStageFlagBits() {
 	switch (type) {
 		case Type::Vertex:
@@ -148,13 +135,40 @@ VkShaderStageFlagBits Shader::getStageFlagBits() {
 			return VK_SHADER_STAGE_MISS_BIT_NV;
 		case Type::Intersection:
 			return VK_SHADER_STAGE_INTERSECTION_BIT_NV;
+		case Type::Compute:
+			return VK_SHADER_STAGE_COMPUTE_BIT;
 		case Type::Callable:
 		default:
 			return VK_SHADER_STAGE_CALLABLE_BIT_NV;
 	}
 }
 
-Shader* Shader::loadFromFile(Device* device, const std::string& path, Type type) {
+Shader* Shader::loadFromFile(Device* device, const std::string& path, Type type, const Defines& defines) {
+	const auto* module = getArchive().find(ShaderArchive::getKey(path, defines));
+
+#ifndef SHADER_ARCHIVE_ONLY
+	// Sources edited since baking are compiled, so a restart does not bring back the old code
+	if (module && isOutdated(*module)) {
+		std::cout << "Shader archive is outdated for '" << ShaderArchive::getKey(path, defines) << "', compiling it" << std::endl;
+		module = nullptr;
+	}
+#endif
+
+	if (module) {
+		return new Shader(device, module->code, type, module->dependencies);
+	}
+
+#ifdef SHADER_ARCHIVE_ONLY
+	throw std::runtime_error(std::string("Shader '") + ShaderArchive::getKey(path, defines) + "' is missing from the archive");
+#else
+	return compileFromFile(device, path, type, defines);
+#endif
+}
+
+Shader* Shader::compileFromFile(Device* device, const std::string& path, Type type, const Defines& defines) {
+#ifdef SHADER_ARCHIVE_ONLY
+	throw std::runtime_error(std::string("Cannot compile '") + path + "', runtime shader compilation is disabled");
+#else
 	std::ifstream f(path);
 	if (!f.is_open()) {
 		throw std::runtime_error(std::string("Failed to open '") + path + "'");
@@ -163,5 +177,6 @@ Shader* Shader::loadFromFile(Device* device, const std::string& path, Type type)
 	std::stringstream buffer;
 	buffer << f.rdbuf();
 
-	return new Shader(device, path, buffer.str(), type);
+	return new Shader(device, path, buffer.str(), type, defines);
+#endif
 }
\ No newline at end of file
@@ -1,11 +1,9 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <vulkan/vulkan.h>
 
-#define NV_EXTENSIONS
-#include <shaderc/shaderc.hpp>
-
 class Device;
 
 class Shader {
@@ -19,10 +17,20 @@ class Shader {
 			ClosestHit,
 			Miss,
 			Intersection,
-			Callable
+			Callable,
+			Compute
 		};
 
-		Shader(Device* device, const std::string& name, const std::string& src, Type type);
+		// Preprocessor macros defined when compiling a shader, used to select permutations
+		typedef std::vector<std::string> Defines;
+
+#ifndef SHADER_ARCHIVE_ONLY
+		// Compiles GLSL source at runtime
+		Shader(Device* device, const std::string& name, const std::string& src, Type type, const Defines& defines = {});
+#endif
+
+		// Creates the module from precompiled SPIR-V
+		Shader(Device* device, const std::vector<uint32_t>& code, Type type, const std::vector<std::string>& dependencies);
 
 		~Shader();
 
@@ -32,15 +40,18 @@ class Shader {
 
 		Type getType() { return type; }
 
-		static Shader* loadFromFile(Device* device, const std::string& path, Type type);
+		// Absolute paths of the source file and all files it includes
+		const std::vector<std::string>& getDependencies() const { return dependencies; }
 
-	private:
-	
-		std::string prepare(const std::string& name, const std::string& src, shaderc::Compiler& compiler, shaderc::CompileOptions& options);
+		// Prefers the precompiled module from the shader archive and falls back to compiling the source, also
+		// if one of the files the module was compiled from is newer than the archive
+		static Shader* loadFromFile(Device* device, const std::string& path, Type type, const Defines& defines = {});
 
-		std::vector<uint32_t> compile(const std::string& name, const std::string& src, shaderc::Compiler& compiler, shaderc::CompileOptions& options);
+		// Always compiles the current source, used when reloading shaders
+		static Shader* compileFromFile(Device* device, const std::string& path, Type type, const Defines& defines = {});
 
-		shaderc_shader_kind getKind();
+	private:
+		void createModule(const std::vector<uint32_t>& code);
 
 		VkShaderStageFlagBits getStageFlagBits();
 
@@ -48,6 +59,8 @@ class Shader {
 
 		Type type;
 
+		std::vector<std::string> dependencies;
+
 		VkShaderModule module = VK_NULL_HANDLE;
 
 		VkPipelineShaderStageCreateInfo stageInfo = {};
@@ -0,0 +1,128 @@
+#include "shader_archive.h"
+
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <stdexcept>
+
+// Layout: header, index of all modules, then the SPIR-V code of every module in index order.
+// Strings are stored as their length followed by the characters, all integers are 32 bit
+static const uint32_t ARCHIVE_MAGIC = 0x41565053; // "SPVA"
+static const uint32_t ARCHIVE_VERSION = 1;
+
+std::string ShaderArchive::getKey(const std::string& path, const std::vector<std::string>& defines) {
+	std::string key = path;
+	for (const auto& d : defines) {
+		key += ";" + d;
+	}
+
+	return key;
+}
+
+void ShaderArchive::add(const std::string& key, const Module& module) {
+	modules[key] = module;
+}
+
+const ShaderArchive::Module* ShaderArchive::find(const std::string& key) const {
+	auto it = modules.find(key);
+	return it != modules.end() ? &it->second : nullptr;
+}
+
+void ShaderArchive::load(const std::string& fileName) {
+	std::ifstream f(fileName, std::ios::binary);
+	if (!f.is_open()) {
+		throw std::runtime_error(std::string("Failed to open '") + fileName + "'");
+	}
+
+	std::vector<char> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+	size_t offset = 0;
+
+	auto read = [&](void* dst, size_t size) {
+		if (offset + size > data.size()) {
+			throw std::runtime_error(std::string("Invalid shader archive '") + fileName + "'");
+		}
+
+		memcpy(dst, data.data() + offset, size);
+		offset += size;
+	};
+
+	auto readUint = [&]() {
+		uint32_t value;
+		read(&value, sizeof(value));
+		return value;
+	};
+
+	auto readString = [&]() {
+		std::string value(readUint(), '\0');
+		read(&value[0], value.size());
+		return value;
+	};
+
+	if (readUint() != ARCHIVE_MAGIC || readUint() != ARCHIVE_VERSION) {
+		throw std::runtime_error(std::string("Invalid shader archive '") + fileName + "'");
+	}
+
+	std::vector<std::pair<std::string, Module>> index(readUint());
+	std::vector<uint32_t> codeSizes;
+
+	for (auto& entry : index) {
+		entry.first = readString();
+		entry.second.dependencies.resize(readUint());
+
+		for (auto& d : entry.second.dependencies) {
+			d = readString();
+		}
+
+		codeSizes.push_back(readUint());
+	}
+
+	modules.clear();
+
+	for (size_t i = 0; i < index.size(); i++) {
+		auto& module = index[i].second;
+		module.code.resize(codeSizes[i]);
+		read(module.code.data(), module.code.size() * sizeof(uint32_t));
+
+		modules[index[i].first] = std::move(module);
+	}
+}
+
+void ShaderArchive::save(const std::string& fileName) const {
+	std::ofstream f(fileName, std::ios::binary);
+	if (!f.is_open()) {
+		throw std::runtime_error(std::string("Failed to open '") + fileName + "'");
+	}
+
+	auto writeUint = [&](size_t value) {
+		auto v = (uint32_t) value;
+		f.write(reinterpret_cast<const char*>(&v), sizeof(v));
+	};
+
+	auto writeString = [&](const std::string& value) {
+		writeUint(value.size());
+		f.write(value.data(), value.size());
+	};
+
+	writeUint(ARCHIVE_MAGIC);
+	writeUint(ARCHIVE_VERSION);
+	writeUint(modules.size());
+
+	for (const auto& m : modules) {
+		writeString(m.first);
+		writeUint(m.second.dependencies.size());
+
+		for (const auto& d : m.second.dependencies) {
+			writeString(d);
+		}
+
+		writeUint(m.second.code.size());
+	}
+
+	for (const auto& m : modules) {
+		f.write(reinterpret_cast<const char*>(m.second.code.data()), m.second.code.size() * sizeof(uint32_t));
+	}
+
+	if (!f) {
+		throw std::runtime_error(std::string("Failed to write '") + fileName + "'");
+	}
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+// Precompiled SPIR-V modules packed into a single indexed file. Modules are keyed by the shader path
+// and the defines of the permutation, and keep the files they were compiled from for hot reloading
+class ShaderArchive {
+
+	public:
+		struct Module {
+			std::vector<uint32_t> code;
+
+			// Paths of the source file and all files it includes, relative to the working directory
+			std::vector<std::string> dependencies;
+		};
+
+		static std::string getKey(const std::string& path, const std::vector<std::string>& defines);
+
+		void add(const std::string& key, const Module& module);
+
+		// Returns nullptr if the archive does not contain the module
+		const Module* find(const std::string& key) const;
+
+		size_t size() const { return modules.size(); }
+
+		void load(const std::string& fileName);
+
+		void save(const std::string& fileName) const;
+
+	private:
+		std::map<std::string, Module> modules;
+};
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "shader_compiler.h"
+
+// Production builds load all shaders from the archive and do not link shaderc
+#ifndef SHADER_ARCHIVE_ONLY
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+
+class Includer : public shaderc::CompileOptions::IncluderInterface {
+
+	private:
+		struct Source {
+			std::string path, content;
+		};
+
+	public:
+		// Handles shaderc_include_resolver_fn callbacks.
+		shaderc_include_result* GetInclude(const char* requested_source,
+			shaderc_include_type type,
+			const char* requesting_source,
+			size_t include_depth) {
+
+			auto rs = new shaderc_include_result();
+			*rs = {};
+
+			auto path = std::filesystem::path(requesting_source)
+				.parent_path()
+				.append(requested_source);
+
+			std::ifstream f(path);
+			if (!f.is_open()) {
+				rs->source_name = "";
+				rs->content = "File not found";
+				return rs;
+			}
+
+			std::stringstream buffer;
+			buffer << f.rdbuf();
+
+			auto src = std::make_unique<Source>();
+			src->path = std::filesystem::absolute(path).lexically_normal().string();
+			src->content = buffer.str();
+
+			rs->source_name = src->path.c_str();
+			rs->source_name_length = src->path.length();
+			rs->content = src->content.c_str();
+			rs->content_length = src->content.length();
+
+			sources.push_back(std::move(src));
+			return rs;
+		}
+
+		// Handles shaderc_include_result_release_fn callbacks.
+		void ReleaseInclude(shaderc_include_result* data) {
+			delete data;
+		}
+
+		std::vector<std::string> getPaths() const {
+			std::vector<std::string> paths;
+			for (const auto& s : sources) {
+				paths.push_back(s->path);
+			}
+
+			return paths;
+		}
+
+	private:
+
+		std::vector<std::unique_ptr<Source>> sources;
+};
+
+ShaderCompiler::Result ShaderCompiler::compile(const std::string& name, const std::string& src, shaderc_shader_kind kind,
+	const std::vector<std::string>& defines, bool optimize) {
+
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	auto includer = std::make_unique<Includer>();
+	auto* includes = includer.get();
+
+	for (const auto& d : defines) {
+		options.AddMacroDefinition(d);
+	}
+
+	if (optimize) {
+		options.SetOptimizationLevel(shaderc_optimization_level_performance);
+	}
+
+	options.SetIncluder(std::move(includer));
+
+	auto prepared = compiler.PreprocessGlsl(src, kind, name.c_str(), options);
+	if (prepared.GetCompilationStatus() != shaderc_compilation_status_success) {
+		std::cout << prepared.GetErrorMessage() << std::endl;
+		throw std::runtime_error("Failed to prepare shader");
+	}
+
+	auto compiled = compiler.CompileGlslToSpv(std::string(prepared.begin(), prepared.end()), kind, name.c_str(), "main", options);
+	if (compiled.GetCompilationStatus() != shaderc_compilation_status_success) {
+		std::cout << compiled.GetErrorMessage() << std::endl;
+		throw std::runtime_error("Failed to compile shader");
+	}
+
+	Result result;
+	result.code = { compiled.begin(), compiled.end() };
+	result.dependencies = includes->getPaths();
+	result.dependencies.push_back(std::filesystem::absolute(name).lexically_normal().string());
+	return result;
+}
+
+ShaderCompiler::Result ShaderCompiler::compileFile(const std::string& path, shaderc_shader_kind kind,
+	const std::vector<std::string>& defines, bool optimize) {
+
+	std::ifstream f(path);
+	if (!f.is_open()) {
+		throw std::runtime_error(std::string("Failed to open '") + path + "'");
+	}
+
+	std::stringstream buffer;
+	buffer << f.rdbuf();
+
+	return compile(path, buffer.str(), kind, defines, optimize);
+}
+
+shaderc_shader_kind ShaderCompiler::getKind(const std::string& path) {
+	auto ext = std::filesystem::path(path).extension().string();
+
+	if (ext == ".vert") return shaderc_vertex_shader;
+	if (ext == ".frag") return shaderc_fragment_shader;
+	if (ext == ".comp") return shaderc_compute_shader;
+	if (ext == ".rgen") return shaderc_raygen_shader;
+	if (ext == ".rahit") return shaderc_anyhit_shader;
+	if (ext == ".rchit") return shaderc_closesthit_shader;
+	if (ext == ".rmiss") return shaderc_miss_shader;
+	if (ext == ".rint") return shaderc_intersection_shader;
+	if (ext == ".rcall") return shaderc_callable_shader;
+
+	throw std::runtime_error(std::string("Unknown shader type '") + path + "'");
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#define NV_EXTENSIONS
+#include <shaderc/shaderc.hpp>
+
+// Compiles GLSL to SPIR-V with shaderc, shared by the runtime and the offline shaderbake tool
+class ShaderCompiler {
+
+	public:
+		struct Result {
+			std::vector<uint32_t> code;
+
+			// Absolute paths of the source file and all files it includes
+			std::vector<std::string> dependencies;
+		};
+
+		// Runs the spirv-opt performance passes on the compiled code if optimize is set
+		static Result compile(const std::string& name, const std::string& src, shaderc_shader_kind kind,
+			const std::vector<std::string>& defines, bool optimize = false);
+
+		static Result compileFile(const std::string& path, shaderc_shader_kind kind,
+			const std::vector<std::string>& defines, bool optimize = false);
+
+		// Shader kind derived from the file extension (.rgen, .rchit, .vert, ...)
+		static shaderc_shader_kind getKind(const std::string& path);
+};
\ No newline at end of file
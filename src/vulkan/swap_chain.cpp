@@ -1,26 +1,60 @@
 #include "swap_chain.h"
 #include "device.h"
 
-SwapChain::SwapChain(Device* device, VkSurfaceKHR surface, VkExtent2D extent, VkFormat format, VkColorSpaceKHR colorSpace, VkPresentModeKHR mode)
+#include <algorithm>
+#include <iostream>
+
+SwapChain::SwapChain(Device* device, VkSurfaceKHR surface, VkExtent2D extent, VkFormat format, VkColorSpaceKHR colorSpace,
+	VkPresentModeKHR mode, uint32_t framesInFlight, SwapChain* oldSwapchain)
 	: format(format), device(device), extent(extent) {
 
 	VkSurfaceCapabilitiesKHR capabilities;
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device->getPhysical(), surface, &capabilities);
 
+	// Present mode, FIFO is the only one every surface has to support
+	uint32_t modeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device->getPhysical(), surface, &modeCount, nullptr);
+
+	std::vector<VkPresentModeKHR> modes(modeCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device->getPhysical(), surface, &modeCount, modes.data());
+
+	if (std::find(modes.begin(), modes.end(), mode) != modes.end()) {
+		presentMode = mode;
+	} else {
+		std::cout << "Present mode " << getPresentModeName(mode) << " not supported, falling back to FIFO" << std::endl;
+	}
+
+	// Only imageCount - minImageCount + 1 images can be acquired at once without blocking, so every frame in
+	// flight beyond the first needs one more image. At least one more than the minimum, and
+	// maxImageCount 0 means there is no limit
+	uint32_t minImageCount = capabilities.minImageCount + std::max(framesInFlight, 2u) - 1;
+
+	if (capabilities.maxImageCount > 0) {
+		minImageCount = std::min(minImageCount, capabilities.maxImageCount);
+	}
+
+	// Surfaces with a current extent require it, the others take the requested one within their limits
+	if (capabilities.currentExtent.width != UINT32_MAX) {
+		this->extent = capabilities.currentExtent;
+	} else {
+		this->extent.width = std::clamp(extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+		this->extent.height = std::clamp(extent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+	}
+
 	VkSwapchainCreateInfoKHR info = {};
 	info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	info.clipped = VK_TRUE;
 	info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	info.surface = device->getSurface();
-	info.minImageCount = capabilities.minImageCount + 1;
+	info.minImageCount = minImageCount;
 	info.imageFormat = format;
 	info.imageColorSpace = colorSpace;
-	info.imageExtent = extent;
+	info.imageExtent = this->extent;
 	info.imageArrayLayers = 1;
-	info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	info.preTransform = capabilities.currentTransform;
-	info.presentMode = mode;
-	info.oldSwapchain = VK_NULL_HANDLE;
+	info.presentMode = presentMode;
+	info.oldSwapchain = oldSwapchain ? oldSwapchain->swapchain : VK_NULL_HANDLE;
 	info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 	if (vkCreateSwapchainKHR(*device, &info, nullptr, &swapchain) != VK_SUCCESS) {
@@ -64,5 +98,24 @@ SwapChain::~SwapChain() {
 		vkDestroyImageView(*device, v, nullptr);
 	}
 
+	for (auto& image : images) {
+		device->getTracker().forget(image);
+	}
+
 	vkDestroySwapchainKHR(*device, swapchain, nullptr);
+}
+
+const char* SwapChain::getPresentModeName(VkPresentModeKHR mode) {
+	switch (mode) {
+		case VK_PRESENT_MODE_IMMEDIATE_KHR:
+			return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR:
+			return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR:
+			return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+			return "fifo_relaxed";
+		default:
+			return "unknown";
+	}
 }
\ No newline at end of file
@@ -7,7 +7,12 @@ class Device;
 
 class SwapChain {
 	public:
-		SwapChain(Device* device, VkSurfaceKHR surface, VkExtent2D extent, VkFormat format, VkColorSpaceKHR colorSpace, VkPresentModeKHR mode);
+		// The present mode falls back to FIFO if the surface does not support it. Enough images are requested
+		// to acquire one per frame in flight without blocking, within the limits of the surface. Recreating
+		// from an old swapchain lets the presentation engine hand over its images, it is retired but still
+		// has to be deleted
+		SwapChain(Device* device, VkSurfaceKHR surface, VkExtent2D extent, VkFormat format, VkColorSpaceKHR colorSpace,
+			VkPresentModeKHR mode, uint32_t framesInFlight, SwapChain* oldSwapchain = nullptr);
 
 		~SwapChain();
 
@@ -21,6 +26,10 @@ class SwapChain {
 
 		const std::vector<VkImageView>& getImageViews() { return imageViews; }
 
+		VkPresentModeKHR getPresentMode() const { return presentMode; }
+
+		static const char* getPresentModeName(VkPresentModeKHR mode);
+
 	private:
 		Device* device = nullptr;
 
@@ -33,4 +42,6 @@ class SwapChain {
 		VkFormat format = VK_FORMAT_UNDEFINED;
 
 		VkExtent2D extent = {};
+
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 };
\ No newline at end of file
@@ -23,11 +23,11 @@ Texture::Texture(Device* device, const std::string& fileName, VkFormat format)
 	// Fill buffer
 	VkDeviceSize size = width * height * 4;
 
-	Buffer localBuffer(device, size,
+	auto localBuffer = new Buffer(device, size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	localBuffer.fill(pixels);
+	localBuffer->fill(pixels);
 	stbi_image_free(pixels);
 
 	// Image
@@ -65,8 +65,8 @@ Texture::Texture(Device* device, const std::string& fileName, VkFormat format)
 
 	vkBindImageMemory(*device, image, memory, 0);
 
-	// Copy data from buffer to image
-	auto commandBuffer = device->beginSingleTimeCommands();
+	// Copy data from buffer to image on the transfer queue, the graphics queue acquires it for the shaders
+	auto commandBuffer = device->beginSingleTimeCommands(Device::QueueType::Transfer);
 
 	device->imageBarrier(commandBuffer, image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
 		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
@@ -82,12 +82,18 @@ Texture::Texture(Device* device, const std::string& fileName, VkFormat format)
 	region.imageOffset = { 0, 0, 0 };
 	region.imageExtent = { (uint32_t) width, (uint32_t) height, 1 };
 
-	vkCmdCopyBufferToImage(commandBuffer, localBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	vkCmdCopyBufferToImage(commandBuffer, *localBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-	device->imageBarrier(commandBuffer, image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+	device->transferOwnership(commandBuffer, image, Device::QueueType::Transfer, Device::QueueType::Graphics,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
 		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-	device->endSingleTimeCommands(commandBuffer);
+	// The frame acquiring the image waits for the upload, the staging buffer is kept until then
+	auto job = device->submitSingleTimeCommands(commandBuffer, Device::QueueType::Transfer);
+
+	device->getScheduler().destroyAfter(job, [localBuffer]() {
+		delete localBuffer;
+	});
 
 	// Create image view
 	VkImageViewCreateInfo viewInfo = {};
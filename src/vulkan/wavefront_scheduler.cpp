@@ -0,0 +1,175 @@
+#include "wavefront_scheduler.h"
+
+#include <cstddef>
+
+// Sizes of the queue entries in shaders/common/types.glsl
+static const VkDeviceSize RAY_SIZE = 64;
+static const VkDeviceSize HIT_SIZE = 48;
+static const VkDeviceSize SHADOW_RAY_SIZE = 64;
+static const VkDeviceSize RADIANCE_SIZE = 16;
+
+// Passes of shaders/wavefront_sort.comp
+static const uint32_t PASS_SCAN = 0;
+static const uint32_t PASS_SCATTER = 1;
+
+// SURFACE_* in shaders/common/constants.glsl
+static const uint32_t SURFACE_NONE = 0;
+static const uint32_t SURFACE_REFLECTIVE = 2;
+static const uint32_t SURFACE_EMISSIVE = 3;
+
+struct ShadePushConstants {
+	uint32_t kind;
+	uint32_t maxBounces;
+};
+
+WavefrontScheduler::WavefrontScheduler(Device* device, Scene* scene, VkExtent2D maxExtent)
+	: device(device), scene(scene) {
+
+	createQueues(maxExtent);
+
+	cameraShader = Shader::loadFromFile(device, "shaders/wavefront_camera.comp", Shader::Type::Compute);
+	cameraPipeline = new ComputePipeline(device, cameraShader);
+
+	sortShader = Shader::loadFromFile(device, "shaders/wavefront_sort.comp", Shader::Type::Compute);
+	sortPipeline = new ComputePipeline(device, sortShader, sizeof(uint32_t));
+
+	for (int i = 0; i < ShadeKernelCount; i++) {
+		shadeShaders[i] = Shader::loadFromFile(device, "shaders/wavefront_shade.comp", Shader::Type::Compute, getShadeKernelDefines((uint32_t) i));
+		shadePipelines[i] = new ComputePipeline(device, shadeShaders[i], sizeof(ShadePushConstants));
+	}
+
+	resolveShader = Shader::loadFromFile(device, "shaders/wavefront_resolve.comp", Shader::Type::Compute);
+	resolvePipeline = new ComputePipeline(device, resolveShader);
+}
+
+WavefrontScheduler::~WavefrontScheduler() {
+	delete resolvePipeline;
+	delete resolveShader;
+
+	for (int i = 0; i < ShadeKernelCount; i++) {
+		delete shadePipelines[i];
+		delete shadeShaders[i];
+	}
+
+	delete sortPipeline;
+	delete sortShader;
+	delete cameraPipeline;
+	delete cameraShader;
+	destroyQueues();
+}
+
+void WavefrontScheduler::resize(VkExtent2D maxExtent) {
+	destroyQueues();
+	createQueues(maxExtent);
+}
+
+void WavefrontScheduler::createQueues(VkExtent2D maxExtent) {
+	VkDeviceSize capacity = (VkDeviceSize) maxExtent.width * maxExtent.height;
+
+	for (auto& buffer : rayBuffers) {
+		buffer = new Buffer(device, capacity * RAY_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	hitBuffer = new Buffer(device, capacity * HIT_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	sortedBuffer = new Buffer(device, capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	shadowRayBuffer = new Buffer(device, capacity * SHADOW_RAY_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	radianceBuffer = new Buffer(device, capacity * RADIANCE_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// Cleared at the start of every trace, and read by the indirect dispatches of the shade kernels
+	stateBuffer = new Buffer(device, sizeof(State),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void WavefrontScheduler::destroyQueues() {
+	delete stateBuffer;
+	delete radianceBuffer;
+	delete shadowRayBuffer;
+	delete sortedBuffer;
+	delete hitBuffer;
+	delete rayBuffers[0];
+	delete rayBuffers[1];
+}
+
+WavefrontScheduler::ShadeKernel WavefrontScheduler::getShadeKernel(uint32_t surfaceKind) {
+	switch (surfaceKind) {
+		case SURFACE_NONE:
+		case SURFACE_EMISSIVE:
+			return ShadeEmission;
+
+		case SURFACE_REFLECTIVE:
+			return ShadeReflective;
+
+		default:
+			return ShadeDiffuse;
+	}
+}
+
+void WavefrontScheduler::use(VkPipelineStageFlags stages, const std::initializer_list<std::pair<Buffer*, VkAccessFlags>>& buffers) {
+	auto& tracker = device->getTracker();
+
+	for (auto& buffer : buffers) {
+		tracker.use(*buffer.first, stages, buffer.second);
+	}
+
+	tracker.flush(device->getCommandBuffer());
+}
+
+void WavefrontScheduler::trace(VkExtent2D extent, uint32_t maxBounces) {
+	auto commandBuffer = device->getCommandBuffer();
+
+	const VkPipelineStageFlags RT = VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV;
+	const VkPipelineStageFlags CS = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	const VkAccessFlags R = VK_ACCESS_SHADER_READ_BIT;
+	const VkAccessFlags W = VK_ACCESS_SHADER_WRITE_BIT;
+	const VkAccessFlags RW = R | W;
+
+	// The previous frame may still read the queues, the tracker waits for it
+	use(VK_PIPELINE_STAGE_TRANSFER_BIT, { { stateBuffer, VK_ACCESS_TRANSFER_WRITE_BIT } });
+	vkCmdFillBuffer(commandBuffer, *stateBuffer, 0, VK_WHOLE_SIZE, 0);
+
+	use(CS, { { rayBuffers[0], W }, { radianceBuffer, W }, { stateBuffer, RW } });
+	cameraPipeline->dispatch(extent);
+
+	ShadePushConstants constants = {};
+	constants.maxBounces = maxBounces;
+
+	// Every bounce runs all stages, the queues become empty once all paths terminated
+	for (uint32_t bounce = 0; bounce <= maxBounces; bounce++) {
+		use(RT, { { rayBuffers[0], RW }, { rayBuffers[1], RW }, { hitBuffer, W }, { stateBuffer, RW } });
+		scene->trace(extent, Scene::RayGen::WavefrontTrace);
+
+		use(CS, { { stateBuffer, RW } });
+		uint32_t pass = PASS_SCAN;
+		sortPipeline->dispatch({ 1, 1 }, &pass);
+
+		use(CS, { { hitBuffer, R }, { sortedBuffer, W }, { stateBuffer, RW } });
+		pass = PASS_SCATTER;
+		sortPipeline->dispatch(extent, &pass);
+
+		// The shade kernels are dispatched with the ranges written by the sort
+		device->getTracker().use(*stateBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+		use(CS, { { stateBuffer, RW }, { sortedBuffer, R }, { hitBuffer, R }, { rayBuffers[0], RW }, { rayBuffers[1], RW },
+			{ shadowRayBuffer, W }, { radianceBuffer, RW } });
+
+		for (uint32_t kind = 0; kind < KINDS; kind++) {
+			constants.kind = kind;
+			shadePipelines[getShadeKernel(kind)]->dispatchIndirect(*stateBuffer,
+				offsetof(State, dispatch) + kind * sizeof(State::dispatch[0]), &constants);
+		}
+
+		use(RT, { { shadowRayBuffer, R }, { radianceBuffer, RW }, { stateBuffer, R } });
+		scene->trace(extent, Scene::RayGen::WavefrontShadow);
+	}
+
+	use(CS, { { radianceBuffer, R } });
+	resolvePipeline->dispatch(extent);
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "device.h"
+#include "buffer.h"
+#include "scene.h"
+#include "compute_pipeline.h"
+#include "compute_permutations.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+// Wavefront path tracer, an alternative to the path tracing loop of primary.rgen for incoherent bounces.
+// Paths are kept in ray queues on the GPU and every bounce runs as a sequence of small kernels:
+// a trace-only ray generation shader, a sort of the hits by surface kind and material, one shade kernel
+// per surface kind over its range of sorted hits, and a trace of the queued shadow rays. Needs the
+// path tracing variant of the scene pipeline, whose hit shaders only report the surface
+class WavefrontScheduler {
+
+	public:
+
+		// Sort keys, have to match shaders/common/constants.glsl. Materials beyond the last share its key
+		static const uint32_t KINDS = 4;
+
+		static const uint32_t MATERIALS = 32;
+
+		static const uint32_t KEYS = KINDS * MATERIALS;
+
+		// Queue counters and sort state, WavefrontState in shaders/common/types.glsl
+		struct State {
+			uint32_t queue;
+			uint32_t shadeQueue;
+			uint32_t rayCount[2];
+			uint32_t shadowRayCount;
+			uint32_t pad[3];
+			uint32_t kindRange[KINDS][4];
+			// VkDispatchIndirectCommand of every shade kernel, padded to 16 bytes
+			uint32_t dispatch[KINDS][4];
+			uint32_t keyCount[KEYS];
+			uint32_t keyOffset[KEYS];
+		};
+
+		static uint32_t getKey(uint32_t surfaceKind, uint32_t material) {
+			return std::min(surfaceKind, KINDS - 1) * MATERIALS + std::min(material, MATERIALS - 1);
+		}
+
+		// Queues hold one entry per pixel of the largest extent that will be traced
+		WavefrontScheduler(Device* device, Scene* scene, VkExtent2D maxExtent);
+
+		~WavefrontScheduler();
+
+		// Traces one path per pixel with up to maxBounces bounces into the color image, and writes the
+		// motion and normal depth images of the primary hits. The caller declares these images to the
+		// tracker, the queues are declared by every kernel
+		void trace(VkExtent2D extent, uint32_t maxBounces);
+
+		// Reallocates the queues for a new largest extent, the pipelines are kept. The GPU must be idle and
+		// the buffers have to be written to the descriptor sets again
+		void resize(VkExtent2D maxExtent);
+
+		const auto& getRayBuffers() const {
+			return rayBuffers;
+		}
+
+		Buffer* getHitBuffer() const {
+			return hitBuffer;
+		}
+
+		Buffer* getSortedBuffer() const {
+			return sortedBuffer;
+		}
+
+		Buffer* getShadowRayBuffer() const {
+			return shadowRayBuffer;
+		}
+
+		Buffer* getStateBuffer() const {
+			return stateBuffer;
+		}
+
+		Buffer* getRadianceBuffer() const {
+			return radianceBuffer;
+		}
+
+	private:
+
+		// Shade kernels, the index is the SHADE_* permutation
+		enum ShadeKernel {
+			ShadeEmission,
+			ShadeDiffuse,
+			ShadeReflective,
+			ShadeKernelCount = SHADE_KERNEL_COUNT
+		};
+
+		static ShadeKernel getShadeKernel(uint32_t surfaceKind);
+
+		void createQueues(VkExtent2D maxExtent);
+
+		void destroyQueues();
+
+		// Declares the queues the next kernel accesses at the given stages to the tracker and flushes it
+		void use(VkPipelineStageFlags stages, const std::initializer_list<std::pair<Buffer*, VkAccessFlags>>& buffers);
+
+		Device* device = nullptr;
+
+		Scene* scene = nullptr;
+
+		Buffer* rayBuffers[2] = { nullptr };
+
+		Buffer* hitBuffer = nullptr;
+
+		Buffer* sortedBuffer = nullptr;
+
+		Buffer* shadowRayBuffer = nullptr;
+
+		Buffer* stateBuffer = nullptr;
+
+		Buffer* radianceBuffer = nullptr;
+
+		Shader* cameraShader = nullptr;
+
+		ComputePipeline* cameraPipeline = nullptr;
+
+		Shader* sortShader = nullptr;
+
+		ComputePipeline* sortPipeline = nullptr;
+
+		Shader* shadeShaders[ShadeKernelCount] = { nullptr };
+
+		ComputePipeline* shadePipelines[ShadeKernelCount] = { nullptr };
+
+		Shader* resolveShader = nullptr;
+
+		ComputePipeline* resolvePipeline = nullptr;
+};
\ No newline at end of file
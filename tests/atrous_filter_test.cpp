@@ -0,0 +1,118 @@
+#include "test.h"
+#include "atrous_filter.h"
+
+#include <cmath>
+#include <stdexcept>
+
+static const uint32_t SIZE = 16;
+
+// RGBA image of SIZE * SIZE pixels, filled by f(x, y, pixel)
+template<typename F>
+static std::vector<float> createImage(F f) {
+	std::vector<float> image(SIZE * SIZE * 4);
+
+	for (uint32_t y = 0; y < SIZE; y++) {
+		for (uint32_t x = 0; x < SIZE; x++) {
+			f(x, y, &image[(y * SIZE + x) * 4]);
+		}
+	}
+
+	return image;
+}
+
+static void setPixel(float* pixel, float r, float g, float b, float a) {
+	pixel[0] = r;
+	pixel[1] = g;
+	pixel[2] = b;
+	pixel[3] = a;
+}
+
+// Facing the camera at the same depth everywhere
+static std::vector<float> createPlane() {
+	return createImage([](uint32_t, uint32_t, float* p) { setPixel(p, 0, 0, 1, 2); });
+}
+
+TEST(atrousConstantImageStaysConstant) {
+	auto color = createImage([](uint32_t, uint32_t, float* p) { setPixel(p, 0.5f, 0.25f, 0.125f, 1); });
+	auto result = AtrousFilter().apply(SIZE, SIZE, color, createPlane());
+
+	for (size_t i = 0; i < result.size(); i += 4) {
+		CHECK(std::abs(result[i + 0] - 0.5f) < 1e-5f);
+		CHECK(std::abs(result[i + 1] - 0.25f) < 1e-5f);
+		CHECK(std::abs(result[i + 2] - 0.125f) < 1e-5f);
+		CHECK(result[i + 3] < 1e-6f);
+	}
+}
+
+TEST(atrousDepthEdgeIsPreserved) {
+	auto color = createImage([](uint32_t x, uint32_t, float* p) {
+		float c = x < SIZE / 2 ? 1.0f : 0.0f;
+		setPixel(p, c, c, c, 1);
+	});
+
+	// Left half close to the camera, right half far behind it
+	auto normalDepth = createImage([](uint32_t x, uint32_t, float* p) {
+		setPixel(p, 0, 0, 1, x < SIZE / 2 ? 1.0f : 10.0f);
+	});
+
+	auto result = AtrousFilter().apply(SIZE, SIZE, color, normalDepth);
+
+	for (uint32_t y = 0; y < SIZE; y++) {
+		for (uint32_t x = 0; x < SIZE; x++) {
+			float expected = x < SIZE / 2 ? 1.0f : 0.0f;
+			CHECK(std::abs(result[(y * SIZE + x) * 4] - expected) < 0.01f);
+		}
+	}
+}
+
+TEST(atrousNoiseIsReduced) {
+	auto color = createImage([](uint32_t x, uint32_t y, float* p) {
+		float c = (x + y) % 2 ? 1.0f : 0.0f;
+		setPixel(p, c, c, c, 1);
+	});
+
+	auto result = AtrousFilter().apply(SIZE, SIZE, color, createPlane());
+
+	// The checkerboard keeps less than half of its contrast
+	for (size_t i = 0; i < result.size(); i += 4) {
+		CHECK(std::abs(result[i] - 0.5f) < 0.25f);
+	}
+}
+
+TEST(atrousMissesAreKept) {
+	auto color = createImage([](uint32_t x, uint32_t y, float* p) {
+		float c = (x + y) % 2 ? 1.0f : 0.0f;
+		setPixel(p, c, c, c, 1);
+	});
+
+	auto normalDepth = createImage([](uint32_t, uint32_t, float* p) { setPixel(p, 0, 0, 0, 0); });
+	auto result = AtrousFilter().apply(SIZE, SIZE, color, normalDepth);
+
+	for (size_t i = 0; i < result.size(); i += 4) {
+		CHECK(result[i] == color[i]);
+		CHECK(result[i + 3] == 0.0f);
+	}
+}
+
+TEST(atrousSingleThreadMatches) {
+	auto color = createImage([](uint32_t x, uint32_t y, float* p) {
+		float c = (float) ((x * 7 + y * 13) % 5) / 4.0f;
+		setPixel(p, c, c * 0.5f, 1 - c, 1);
+	});
+
+	auto normalDepth = createPlane();
+
+	auto single = AtrousFilter(AtrousFilter::Settings(), 1).apply(SIZE, SIZE, color, normalDepth);
+	auto multi = AtrousFilter(AtrousFilter::Settings(), 4).apply(SIZE, SIZE, color, normalDepth);
+
+	CHECK(single == multi);
+}
+
+TEST(atrousEmptyExtent) {
+	CHECK(AtrousFilter().apply(0, 0, {}, {}).empty());
+	CHECK(AtrousFilter().apply(SIZE, 0, {}, {}).empty());
+}
+
+TEST(atrousSizeMismatchThrows) {
+	CHECK_THROWS(AtrousFilter().apply(SIZE, SIZE, {}, {}), std::logic_error);
+}
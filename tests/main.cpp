@@ -0,0 +1,41 @@
+#include "test.h"
+
+#include <exception>
+#include <iostream>
+
+static int failures = 0;
+
+std::vector<test::Case>& test::getCases() {
+	static std::vector<Case> cases;
+	return cases;
+}
+
+void test::fail(const char* file, int line, const std::string& message) {
+	std::cout << file << "(" << line << "): " << message << std::endl;
+	failures++;
+}
+
+// Runs all test cases, the exit code is the number of failed cases so the build fails with them
+int main() {
+	int failedCases = 0;
+
+	for (const auto& c : test::getCases()) {
+		int previous = failures;
+
+		try {
+			c.run();
+		} catch (const std::exception& e) {
+			std::cout << c.name << ": " << e.what() << std::endl;
+			failures++;
+		}
+
+		if (failures != previous) {
+			std::cout << "FAILED " << c.name << std::endl;
+			failedCases++;
+		}
+	}
+
+	std::cout << test::getCases().size() - failedCases << " of " << test::getCases().size() << " tests passed" << std::endl;
+
+	return failedCases;
+}
@@ -0,0 +1,56 @@
+#include "test.h"
+#include "ray_sorter.h"
+
+#include <stdexcept>
+
+TEST(raySorterGroupsByKeyStably) {
+	RaySorter sorter(4);
+	auto order = sorter.sort({ 2, 0, 3, 2, 0, 2 });
+
+	CHECK((order == std::vector<uint32_t>{ 1, 4, 0, 3, 5, 2 }));
+}
+
+TEST(raySorterRanges) {
+	RaySorter sorter(4);
+	sorter.sort({ 2, 0, 3, 2, 0, 2 });
+
+	CHECK(sorter.getBegin(0) == 0);
+	CHECK(sorter.getEnd(0) == 2);
+
+	// Key 1 has no rays, its range is empty
+	CHECK(sorter.getBegin(1) == 2);
+	CHECK(sorter.getEnd(1) == 2);
+
+	CHECK(sorter.getBegin(2) == 2);
+	CHECK(sorter.getEnd(2) == 5);
+
+	CHECK(sorter.getBegin(3) == 5);
+	CHECK(sorter.getEnd(3) == 6);
+}
+
+TEST(raySorterRangesFollowTheLastSort) {
+	RaySorter sorter(2);
+	sorter.sort({ 0, 0, 0 });
+	auto order = sorter.sort({ 1, 0 });
+
+	CHECK((order == std::vector<uint32_t>{ 1, 0 }));
+	CHECK(sorter.getEnd(0) == 1);
+	CHECK(sorter.getEnd(1) == 2);
+}
+
+TEST(raySorterEmpty) {
+	RaySorter sorter(3);
+
+	CHECK(sorter.sort({}).empty());
+	CHECK(sorter.getBegin(0) == 0);
+	CHECK(sorter.getEnd(2) == 0);
+}
+
+TEST(raySorterKeyOutOfRangeThrows) {
+	RaySorter sorter(2);
+
+	CHECK_THROWS(sorter.sort({ 0, 2 }), std::out_of_range);
+	CHECK_THROWS(sorter.getBegin(2), std::out_of_range);
+	CHECK_THROWS(sorter.getEnd(2), std::out_of_range);
+	CHECK_THROWS(RaySorter(0), std::logic_error);
+}
@@ -0,0 +1,226 @@
+#include "test.h"
+#include "render_graph.h"
+
+#include <stdexcept>
+
+// Stages and access are opaque to the compiler, these only tell the uses apart
+static RenderGraph::Usage usage(uint32_t stages, uint32_t layout = 0) {
+	RenderGraph::Usage usage;
+	usage.stages = stages;
+	usage.access = stages;
+	usage.layout = layout;
+	return usage;
+}
+
+TEST(renderGraphCullsPassesWithoutOutput) {
+	RenderGraph graph;
+	auto output = graph.addResource("output");
+	auto unused = graph.addResource("unused", true, 16);
+	auto unusedResult = graph.addResource("unusedResult", true, 16);
+	graph.setOutput(output);
+
+	auto first = graph.addPass("first");
+	graph.write(first, unused, usage(1));
+
+	auto second = graph.addPass("second");
+	graph.read(second, unused, usage(2));
+	graph.write(second, unusedResult, usage(2));
+
+	auto kept = graph.addPass("kept");
+	graph.write(kept, output, usage(4));
+
+	graph.compile();
+
+	CHECK(graph.isCulled(first));
+	CHECK(graph.isCulled(second));
+	CHECK(!graph.isCulled(kept));
+	CHECK((graph.getOrder() == std::vector<uint32_t>{ kept }));
+
+	// Culled passes do not keep their resources alive
+	CHECK(graph.getFirstPass(unused) == RenderGraph::UNUSED);
+	CHECK(graph.getTransientSize() == 0);
+}
+
+TEST(renderGraphKeepsPassesTheOutputReads) {
+	RenderGraph graph;
+	auto output = graph.addResource("output");
+	auto overwritten = graph.addResource("overwritten");
+	graph.setOutput(output);
+
+	// The first write is replaced before anything reads it
+	auto replaced = graph.addPass("replaced");
+	graph.write(replaced, overwritten, usage(1));
+
+	auto source = graph.addPass("source");
+	graph.write(source, overwritten, usage(1));
+
+	auto result = graph.addPass("result");
+	graph.read(result, overwritten, usage(2));
+	graph.write(result, output, usage(2));
+
+	graph.compile();
+
+	CHECK(graph.isCulled(replaced));
+	CHECK((graph.getOrder() == std::vector<uint32_t>{ source, result }));
+}
+
+TEST(renderGraphTransientsWithDisjointLifetimesShareMemory) {
+	RenderGraph graph;
+	auto history = graph.addResource("history");
+	auto output = graph.addResource("output");
+	auto first = graph.addResource("first", true, 256, 16);
+	auto second = graph.addResource("second", true, 128, 16);
+	graph.setOutput(output);
+
+	auto writeFirst = graph.addPass("writeFirst");
+	graph.write(writeFirst, first, usage(1));
+
+	auto readFirst = graph.addPass("readFirst");
+	graph.read(readFirst, first, usage(2));
+	graph.write(readFirst, history, usage(2));
+
+	auto writeSecond = graph.addPass("writeSecond");
+	graph.read(writeSecond, history, usage(4));
+	graph.write(writeSecond, second, usage(4));
+
+	auto readSecond = graph.addPass("readSecond");
+	graph.read(readSecond, second, usage(8));
+	graph.write(readSecond, output, usage(8));
+
+	graph.compile();
+
+	CHECK(graph.getOffset(first) == 0);
+	CHECK(graph.getOffset(second) == 0);
+	CHECK(graph.getTransientSize() == 256);
+
+	// The second resource waits for the last use of the first one in the same memory
+	bool aliasing = false;
+
+	for (const auto& d : graph.getDependencies(writeSecond)) {
+		if (d.aliasing) {
+			aliasing = d.resource == second && d.srcPass == readFirst && d.srcUsage.stages == 2 && d.dstUsage.stages == 4;
+		}
+	}
+
+	CHECK(aliasing);
+}
+
+TEST(renderGraphTransientsAliveTogetherDoNotOverlap) {
+	RenderGraph graph;
+	auto output = graph.addResource("output");
+	auto a = graph.addResource("a", true, 100, 64);
+	auto b = graph.addResource("b", true, 100, 64);
+	graph.setOutput(output);
+
+	auto write = graph.addPass("write");
+	graph.write(write, a, usage(1));
+	graph.write(write, b, usage(1));
+
+	auto read = graph.addPass("read");
+	graph.read(read, a, usage(2));
+	graph.read(read, b, usage(2));
+	graph.write(read, output, usage(2));
+
+	graph.compile();
+
+	// First fit after the other one, aligned
+	CHECK(graph.getOffset(a) == 0);
+	CHECK(graph.getOffset(b) == 128);
+	CHECK(graph.getTransientSize() == 228);
+}
+
+TEST(renderGraphConflictingPlacementThrows) {
+	RenderGraph graph;
+	auto output = graph.addResource("output");
+	auto a = graph.addResource("a", true, 64);
+	auto b = graph.addResource("b", true, 64);
+	graph.setOutput(output);
+
+	auto write = graph.addPass("write");
+	graph.write(write, a, usage(1));
+	graph.write(write, b, usage(1));
+
+	auto read = graph.addPass("read");
+	graph.read(read, a, usage(2));
+	graph.read(read, b, usage(2));
+	graph.write(read, output, usage(2));
+
+	graph.placeResource(a, 0);
+	graph.placeResource(b, 32);
+
+	CHECK_THROWS(graph.compile(), std::logic_error);
+
+	// Placed next to each other, they compile
+	graph.placeResource(b, 64);
+	graph.compile();
+
+	CHECK(graph.getOffset(b) == 64);
+}
+
+TEST(renderGraphWriteAfterReadDependency) {
+	RenderGraph graph;
+	auto shared = graph.addResource("shared");
+	auto output = graph.addResource("output");
+	graph.setOutput(shared);
+	graph.setOutput(output);
+
+	auto produce = graph.addPass("produce");
+	graph.write(produce, shared, usage(1));
+
+	auto consume = graph.addPass("consume");
+	graph.read(consume, shared, usage(2));
+	graph.write(consume, output, usage(2));
+
+	auto overwrite = graph.addPass("overwrite");
+	graph.write(overwrite, shared, usage(4));
+
+	graph.compile();
+
+	const auto& read = graph.getDependencies(consume);
+	CHECK(read.size() == 1 && read[0].resource == shared && read[0].srcPass == produce && !read[0].aliasing);
+
+	// The overwrite waits for the read, not for the write before it
+	const auto& write = graph.getDependencies(overwrite);
+	CHECK(write.size() == 1 && write[0].srcPass == consume && write[0].srcUsage.stages == 2 && write[0].dstUsage.write);
+}
+
+TEST(renderGraphLayoutChangeCountsAsWrite) {
+	RenderGraph graph;
+	auto image = graph.addResource("image");
+	auto outputA = graph.addResource("outputA");
+	auto outputB = graph.addResource("outputB");
+	graph.setOutput(outputA);
+	graph.setOutput(outputB);
+
+	auto write = graph.addPass("write");
+	graph.write(write, image, usage(1, 1));
+
+	auto readA = graph.addPass("readA");
+	graph.read(readA, image, usage(2, 1));
+	graph.write(readA, outputA, usage(2));
+
+	// Reading in another layout transitions the image, which has to wait for the earlier read
+	auto readB = graph.addPass("readB");
+	graph.read(readB, image, usage(4, 2));
+	graph.write(readB, outputB, usage(4));
+
+	graph.compile();
+
+	bool transition = false;
+
+	for (const auto& d : graph.getDependencies(readB)) {
+		transition |= d.resource == image && d.srcPass == readA;
+	}
+
+	CHECK(transition);
+}
+
+TEST(renderGraphChangedGraphHasToBeCompiled) {
+	RenderGraph graph;
+	graph.addPass("pass");
+	graph.compile();
+
+	graph.addResource("late");
+
+	CHECK_THROWS(graph.getOrder(), std::logic_error);
+}
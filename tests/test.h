@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Minimal test harness for the parts that run without a device. TEST defines a test case, CHECK reports a
+// failed condition and continues with the case, exceptions escaping a case fail it
+namespace test {
+
+	struct Case {
+		const char* name;
+
+		void (*run)();
+	};
+
+	std::vector<Case>& getCases();
+
+	void fail(const char* file, int line, const std::string& message);
+
+	struct Registration {
+		Registration(const char* name, void (*run)()) {
+			getCases().push_back({ name, run });
+		}
+	};
+}
+
+#define TEST(name) \
+	static void name(); \
+	static test::Registration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			test::fail(__FILE__, __LINE__, #condition); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(expression, exception) \
+	do { \
+		try { \
+			expression; \
+			test::fail(__FILE__, __LINE__, #expression " does not throw " #exception); \
+		} catch (const exception&) { \
+		} \
+	} while (false)
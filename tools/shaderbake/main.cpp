@@ -0,0 +1,81 @@
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "shader_archive.h"
+#include "shader_compiler.h"
+#include "material_features.h"
+#include "compute_permutations.h"
+
+// Compiles all ray tracing and compute shaders of a directory and packs them into a shader archive.
+// Hit shaders are compiled once for every material feature combination, compute shaders once per permutation
+int main(int argc, char** argv) {
+	bool optimize = false;
+	std::vector<std::string> args;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if (arg == "-O") {
+			optimize = true;
+		} else {
+			args.push_back(arg);
+		}
+	}
+
+	if (args.size() != 2) {
+		std::cout << "Usage: shaderbake [-O] <shader directory> <archive>" << std::endl;
+		return 1;
+	}
+
+	try {
+		ShaderArchive archive;
+		auto cwd = std::filesystem::current_path();
+
+		for (const auto& entry : std::filesystem::directory_iterator(args[0])) {
+			auto ext = entry.path().extension().string();
+			if (!entry.is_regular_file() || (ext.compare(0, 2, ".r") != 0 && ext != ".comp")) {
+				continue;
+			}
+
+			// Keys use the path the application passes to Shader::loadFromFile
+			auto path = entry.path().generic_string();
+			auto kind = ShaderCompiler::getKind(path);
+
+			std::vector<std::vector<std::string>> permutations = { {} };
+			if (kind == shaderc_closesthit_shader || kind == shaderc_anyhit_shader) {
+				permutations.clear();
+
+				for (uint32_t features = 0; features <= MATERIAL_FEATURE_ALL; features++) {
+					permutations.push_back(getMaterialDefines(features));
+				}
+			} else if (kind == shaderc_compute_shader) {
+				permutations = getComputePermutations(entry.path().filename().string());
+			}
+
+			for (const auto& defines : permutations) {
+				auto key = ShaderArchive::getKey(path, defines);
+				auto result = ShaderCompiler::compileFile(path, kind, defines, optimize);
+
+				ShaderArchive::Module module;
+				module.code = result.code;
+
+				for (const auto& d : result.dependencies) {
+					module.dependencies.push_back(std::filesystem::relative(d, cwd).generic_string());
+				}
+
+				archive.add(key, module);
+				std::cout << key << " (" << module.code.size() * sizeof(uint32_t) << " bytes)" << std::endl;
+			}
+		}
+
+		archive.save(args[1]);
+		std::cout << "Wrote " << archive.size() << " shaders to '" << args[1] << "'" << std::endl;
+	} catch (const std::exception& e) {
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file